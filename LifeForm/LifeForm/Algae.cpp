@@ -6,8 +6,10 @@
 #include "Algae.h"
 #include "Event.h"
 #include "Params.h"
+#include "SlabPool.h"
 #include "tokens.h"
 #include "Window.h"
+#include "World.h"
 
 using namespace std;
 using String = std::string;
@@ -17,8 +19,19 @@ Initializer<Algae> __Algae_initializer;
 void Algae::initialize(void)
 {
     LifeForm::add_creator(Algae::create, "Algae");
+    Event::add_kind(&on_photosynthesize, "Algae::photosynthesize");
 }
 
+#if (SLAB_POOLS)
+void* Algae::operator new(size_t bytes) {
+    return SlabPool<Algae>::the_pool("Algae").allocate(bytes);
+}
+
+void Algae::operator delete(void* p, size_t bytes) {
+    SlabPool<Algae>::the_pool("Algae").release(p, bytes);
+}
+#endif /* SLAB_POOLS */
+
 String Algae::species_name(void) const
 {
     return "Algae";
@@ -30,9 +43,7 @@ String Algae::player_name(void) const
 }
 
 Algae::Algae(void) {
-    SmartPointer<Algae> self{ this };
-    photo_event = new Event(algae_photo_time,
-        [self](void) { self->photosynthesize(); });
+    photo_event = new Event(algae_photo_time, &on_photosynthesize, this);
 }
 
 void Algae::draw(int x, int y) const
@@ -40,7 +51,7 @@ void Algae::draw(int x, int y) const
 #if DEBUG
     cout << "drawing Algae";
 #endif /* DEBUG */
-    win.draw_rectangle(x, y, x + 3, y + 3, true);
+    world->win.draw_rectangle(x, y, x + 3, y + 3, true);
 }
 
 Color Algae::my_color(void) const
@@ -61,14 +72,12 @@ Action Algae::encounter(const ObjInfo&)
 void Algae::photosynthesize(void)
 {
     photo_event = 0;
-    if (!is_alive) { return; }
-    energy += Algae_energy_gain;
-    if (energy > 2.0 * start_energy) {
+    if (!is_alive()) { return; }
+    add_energy(Algae_energy_gain);
+    if (energy() > 2.0 * start_energy) {
         SmartPointer<Algae> child = new Algae;
         reproduce(child);
     }
-    SmartPointer<Algae> self{ this };
-    photo_event = new Event(algae_photo_time,
-        [self](void) { self->photosynthesize(); });
+    photo_event = new Event(algae_photo_time, &on_photosynthesize, this);
 }
 
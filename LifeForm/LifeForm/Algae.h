@@ -8,7 +8,12 @@
 class Algae : public LifeForm {
   static void initialize(void);
   Event* photo_event;
+  void event_members(std::vector<Event**>& out) {
+    LifeForm::event_members(out);
+    out.push_back(&photo_event);
+  }
   void photosynthesize(void);
+  static void on_photosynthesize(LifeForm* a, double) { static_cast<Algae*>(a)->photosynthesize(); }
 public:
   Algae(void);
   void draw(int,int) const;     // defines LifeForm::draw
@@ -17,7 +22,12 @@ public:
   std::string player_name(void) const;
   virtual Action encounter(const ObjInfo&);
   static SmartPointer<LifeForm> create(void);
-  static void create_spontaneously(void);
+  static void create_spontaneously(void);        // algae_spores of them
+  static void create_spontaneously(unsigned count);
+#if (SLAB_POOLS)
+  static void* operator new(size_t);            // from SlabPool<Algae>
+  static void operator delete(void*, size_t);
+#endif /* SLAB_POOLS */
   friend class Initializer<Algae>;
 };
 
@@ -0,0 +1,74 @@
+#include "Behavior.h"
+
+#if (BEHAVIORS)
+#include <cstddef>
+
+#include "SlabPool.h"
+
+using namespace std;
+
+Initializer<Actor> __Actor_initializer;
+
+/*
+ * a frame is the Behavior's locals and where it is waiting, a few
+ * hundred bytes at most for the species' loops, so frames come from two
+ * pools of fixed size slots (bigger ones from the system)
+ */
+template <size_t N>
+struct Frame {
+    alignas(max_align_t) unsigned char bytes[N];
+};
+static const size_t small_frame = 256;
+static const size_t large_frame = 1024;
+
+void* Behavior::promise_type::operator new(size_t bytes) {
+    if (bytes <= small_frame) {
+        return SlabPool<Frame<small_frame>>::the_pool("Behavior").allocate(sizeof(Frame<small_frame>));
+    }
+    if (bytes <= large_frame) {
+        return SlabPool<Frame<large_frame>>::the_pool("Behavior (large)").allocate(sizeof(Frame<large_frame>));
+    }
+    return ::operator new(bytes);
+}
+
+void Behavior::promise_type::operator delete(void* p, size_t bytes) {
+    if (bytes <= small_frame) {
+        SlabPool<Frame<small_frame>>::the_pool("Behavior").release(p, sizeof(Frame<small_frame>));
+    }
+    else if (bytes <= large_frame) {
+        SlabPool<Frame<large_frame>>::the_pool("Behavior (large)").release(p, sizeof(Frame<large_frame>));
+    }
+    else {
+        ::operator delete(p);
+    }
+}
+
+void Actor::initialize(void) {
+    Event::add_kind(&on_wake, "Actor::wake");
+}
+
+/* (the Behavior starts with the first event, when the Actor is alive) */
+Actor::Actor(void) {
+    wake_event = new Event(0, &on_wake, this);
+}
+
+void Actor::wake(void) {
+    if (wake_event == nullptr) {    // it is running: don't let it fall asleep
+        woken = true;
+        return;
+    }
+    wake_event->cancel();
+    wake_event = new Event(0.0, &on_wake, this);
+}
+
+void Actor::resume(void) {
+    wake_event = nullptr;
+    if (health() == 0.0) return;    // we died
+    if (!started) {
+        started = true;
+        behavior = behave();
+    }
+    behavior.resume();
+}
+
+#endif /* BEHAVIORS */
@@ -0,0 +1,147 @@
+#if !(_Behavior_h)
+#define _Behavior_h 1
+
+/*
+ * Behaviors are C++20 coroutines, so they are only there when the
+ * compiler has coroutines (e.g. "make STD=c++20", see the Makefile);
+ * BEHAVIORS says whether it has
+ */
+#if defined(__cpp_impl_coroutine)
+#define BEHAVIORS 1
+#else
+#define BEHAVIORS 0
+#endif
+
+#if (BEHAVIORS)
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+#include "Event.h"
+#include "Init.h"
+#include "LifeForm.h"
+#include "ObjInfo.h"
+
+/*
+ * Class name: Behavior
+ * Description:
+ *  A coroutine that is what an Actor does (see below), e.g.
+ *      Behavior Hunter::behave(void) {
+ *          while (health() > 0.0) {
+ *              const ObjList& prey = co_await perceive(20.0);
+ *              ...
+ *              co_await sleep(10.0);
+ *          }
+ *      }
+ *  instead of a handler that does one step and schedules an Event for
+ *  the next one.  Its frame (the locals that are kept while it sleeps)
+ *  is made once, from a SlabPool of frames, and the event queue resumes
+ *  it directly.  A Behavior doesn't start until it is resumed, and
+ *  destroys its frame when it is destroyed.
+ */
+class Behavior {
+public:
+    struct promise_type {
+        Behavior get_return_object(void) {
+            return Behavior(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend(void) noexcept { return {}; }
+        std::suspend_always final_suspend(void) noexcept { return {}; }
+        void return_void(void) {}
+        void unhandled_exception(void) { std::terminate(); }
+
+        static void* operator new(size_t);          // from the frame pools
+        static void operator delete(void*, size_t);
+    };
+
+    Behavior(void) {}
+    Behavior(Behavior&& b) : frame(b.frame) { b.frame = nullptr; }
+    Behavior& operator=(Behavior&& b) {
+        if (this != &b) {
+            if (frame) frame.destroy();
+            frame = b.frame;
+            b.frame = nullptr;
+        }
+        return *this;
+    }
+    ~Behavior(void) { if (frame) frame.destroy(); }
+
+    bool done(void) const { return !frame || frame.done(); }
+    void resume(void) { if (!done()) frame.resume(); }
+
+private:
+    explicit Behavior(std::coroutine_handle<promise_type> h) : frame(h) {}
+    std::coroutine_handle<promise_type> frame;
+
+    Behavior(const Behavior&) = delete;
+    void operator=(const Behavior&) = delete;
+};
+
+/*
+ * Class name: Actor
+ * Description:
+ *  A LifeForm whose species writes what it does as one Behavior (behave)
+ *  instead of a chain of events.  The Behavior starts when the Actor's
+ *  first event runs (it can't start in the constructor, see Craig.cpp),
+ *  and it waits with
+ *      co_await sleep(dt);             // dt time units, or until wake()
+ *      const ObjList& l = co_await perceive(r);    // (perceiving takes no time)
+ *  (l is the Actor's own list, which the next perceive reuses).
+ *  Sleeping is an Event of a kind ("Actor::wake"), so an Actor's
+ *  runs can be traced and replayed, and it moves from tile to tile with
+ *  the Actor.  The frame itself can't be saved: an Actor that is
+ *  restored from a checkpoint (or remade by another process, see
+ *  ShardedWorld.h) starts its Behavior over when it next wakes up, and
+ *  a TimeWarp (-T) can't roll an Actor back.
+ */
+class Actor : public LifeForm {
+protected:
+    Actor(void);
+
+    virtual Behavior behave(void) = 0;  // what it does, until it returns or dies
+
+    struct Sleep {
+        Actor& actor;
+        double dt;
+        bool await_ready(void) const noexcept { return actor.woken; }
+        void await_suspend(std::coroutine_handle<>) { actor.wake_event = new Event(dt, &on_wake, &actor); }
+        void await_resume(void) noexcept { actor.woken = false; }
+    };
+    Sleep sleep(double dt) { return Sleep{ *this, dt }; }
+
+    struct Perceive {
+        Actor& actor;
+        double radius;
+        bool await_ready(void) const noexcept { return true; }
+        void await_suspend(std::coroutine_handle<>) {}
+        const ObjList& await_resume(void) {
+            actor.perceive_into(radius, actor.seen);
+            return actor.seen;
+        }
+    };
+    Perceive perceive(double radius) { return Perceive{ *this, radius }; }
+
+    void wake(void);            // end the sleep now (or the next one, if it is awake)
+
+    void event_members(std::vector<Event**>& out) {
+        LifeForm::event_members(out);
+        out.push_back(&wake_event);
+    }
+
+private:
+    Behavior behavior;
+    bool started = false;
+    bool woken = false;
+    Event* wake_event;
+    ObjList seen;               // what the last perceive found (reused by the next one)
+
+    static void initialize(void);
+    static void on_wake(LifeForm* a, double) { static_cast<Actor*>(a)->resume(); }
+    void resume(void);
+
+    friend class Initializer<Actor>;
+};
+
+#endif /* BEHAVIORS */
+#endif /* !(_Behavior_h) */
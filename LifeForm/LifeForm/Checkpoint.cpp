@@ -0,0 +1,265 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+#include "Checkpoint.h"
+#include "Event.h"
+#include "LifeForm.h"
+#include "Packet.h"
+#include "World.h"
+
+using namespace std;
+
+/* the first thing in every checkpoint, with the version of the layout */
+static const string header = "EPL checkpoint 2";
+
+Checkpoint::Checkpoint(const string& t) : target(t)
+{
+    worker = thread([this](void) { run(); });
+}
+
+bool Checkpoint::save(World& world)
+{
+    World::Scope in(world);
+    const vector<Event*>& queue = world.equeue.contents();
+
+    /* the living LifeForms (in the order of their rows), and then the
+       dead ones that events are still about */
+    vector<LifeForm*> lives(world.all_life.living().begin(), world.all_life.living().end());
+    unordered_map<const LifeForm*, int32_t> life_at;
+    for (LifeForm* lf : lives) {
+        life_at[lf] = (int32_t) life_at.size();
+    }
+    unordered_map<const Event*, int32_t> event_at;
+    for (Event* e : queue) {
+        if (Event::kind_name(e->kind) == nullptr) {
+            cerr << "Checkpoint: an event with no kind can't be saved\n";
+            return false;
+        }
+        event_at[e] = (int32_t) event_at.size();
+        if (e->owner && life_at.count(e->owner) == 0) {
+            life_at[e->owner] = (int32_t) lives.size();
+            lives.push_back(e->owner);
+        }
+    }
+
+    Packet out;
+    out.put_string(header);
+    out.put(world.now);
+    out.put((uint64_t) world.seed);
+    out.put(world.random);
+    out.put(world.num_streams);
+    out.put((int32_t) world.max_species);
+    out.put((uint32_t) world.species_stats.size());
+    for (size_t k = 0; k < world.species_stats.size(); k += 1) {
+        out.put_string(Species::at((Species::Id) k).name());
+        out.put(world.species_stats[k]);
+    }
+
+    const LifeFormState& rows = world.all_life;
+    out.put((uint32_t) rows.num_alive());
+    out.put((uint32_t) lives.size());
+    for (LifeForm* lf : lives) {
+        uint32_t r = lf->vector_pos;
+        out.put_string(lf->species().name());
+        out.put_point(rows.pos[r]);
+        out.put(rows.speed[r]);
+        out.put(rows.course[r]);
+        out.put(rows.update_time[r]);
+        out.put(rows.energy[r]);
+        out.put(rows.dir_x[r]);
+        out.put(rows.dir_y[r]);
+        out.put(rows.move_cost[r]);
+        out.put(lf->reproduce_time);
+        out.put_point(lf->start_point);
+        out.put(lf->random);
+        out.put(lf->handle);
+        Packet state;
+        lf->save_state(state);
+        out.put_string(string(state.bytes.begin(), state.bytes.end()));
+    }
+
+    out.put((uint32_t) queue.size());
+    for (Event* e : queue) {
+        out.put_string(*Event::kind_name(e->kind));
+        out.put(e->t);
+        out.put(e->seq);
+        out.put((uint8_t) e->active);
+        out.put(e->owner ? life_at[e->owner] : (int32_t) -1);
+        out.put(e->arg);
+    }
+
+    /* (a member that points to an event that isn't pending is stale) */
+    vector<Event**> members;
+    for (LifeForm* lf : lives) {
+        members.clear();
+        lf->event_members(members);
+        out.put((uint32_t) members.size());
+        for (Event** m : members) {
+            auto i = event_at.find(*m);
+            out.put(i == event_at.end() ? (int32_t) -1 : i->second);
+        }
+    }
+
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this](void) { return pending.size() < max_pending; });
+    pending.push_back(std::move(out.bytes));
+    num_saved += 1;
+    changed.notify_all();
+    return true;
+}
+
+void Checkpoint::close(void)
+{
+    if (!worker.joinable()) return;
+    {
+        lock_guard<mutex> guard(lock);
+        closing = true;
+        changed.notify_all();
+    }
+    worker.join();
+}
+
+/* write checkpoints as they arrive, until close is called and nothing is left */
+void Checkpoint::run(void)
+{
+    string temp = target + ".tmp";
+    for (;;) {
+        Buffer b;
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this](void) { return closing || !pending.empty(); });
+            if (pending.empty()) return;    // closing, and all written
+            b.swap(pending.front());
+            pending.pop_front();
+            changed.notify_all();           // there is room in pending now
+        }
+
+        FILE* file = fopen(temp.c_str(), "wb");
+        bool good = file != nullptr && fwrite(b.data(), 1, b.size(), file) == b.size();
+        if (file != nullptr && fclose(file) != 0) good = false;
+        if (!good || rename(temp.c_str(), target.c_str()) != 0) {
+            cerr << "Checkpoint: cannot write " << target << "\n";
+        }
+    }
+}
+
+/*
+ * the LifeForms are remade by their species' creators, which make the
+ * events that a new LifeForm starts with.  those are thrown away, and the
+ * saved ones are made again in their place (once all of the LifeForms
+ * exist, so that any of them can be an owner)
+ */
+bool Checkpoint::restore(World& world, const string& file)
+{
+    ifstream in(file, ios::binary);
+    if (!in) {
+        cerr << "Checkpoint: cannot open " << file << "\n";
+        return false;
+    }
+    Packet p;
+    p.bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    auto bad = [&file](const string& why) {
+        cerr << "Checkpoint: " << file << ": " << why << "\n";
+        return false;
+    };
+    if (p.get_string() != header) return bad("not a checkpoint");
+
+    World::Scope scope(world);
+    world.now = p.get<SimTime>();
+    uint64_t seed = p.get<uint64_t>();
+    RandomStream random = p.get<RandomStream>();
+    uint64_t num_streams = p.get<uint64_t>();
+    int32_t max_species = p.get<int32_t>();
+    vector<pair<string, SpeciesStats>> totals(p.get<uint32_t>());
+    for (auto& t : totals) {
+        if (!p.ok()) break;
+        t.first = p.get_string();
+        t.second = p.get<SpeciesStats>();
+    }
+
+    uint32_t num_alive = p.get<uint32_t>();
+    vector<SmartPointer<LifeForm>> lives(p.ok() ? p.get<uint32_t>() : 0);
+    if (!p.ok() || num_alive > lives.size()) return bad("truncated");
+    LifeFormState& rows = world.all_life;
+    for (SmartPointer<LifeForm>& lf : lives) {
+        string name = p.get_string();
+        auto creator = LifeForm::istream_creators().find(name);
+        if (creator == LifeForm::istream_creators().end()) return bad("no species " + name);
+        lf = creator->second();
+        uint32_t r = lf->vector_pos;
+        rows.pos[r] = p.get_point();
+        rows.speed[r] = p.get<double>();
+        rows.course[r] = p.get<double>();
+        rows.update_time[r] = p.get<double>();
+        rows.energy[r] = p.get<double>();
+        rows.dir_x[r] = p.get<double>();
+        rows.dir_y[r] = p.get<double>();
+        rows.move_cost[r] = p.get<double>();
+        lf->reproduce_time = p.get<double>();
+        lf->start_point = p.get_point();
+        lf->random = p.get<RandomStream>();
+        lf->handle = p.get<uint64_t>();
+        string bytes = p.get_string();
+        Packet state;
+        state.bytes.assign(bytes.begin(), bytes.end());
+        lf->restore_state(state);
+        if (!p.ok() || !state.done()) return bad("truncated");
+    }
+
+    /* the rows of the living are revived in order, so they come out in
+       the order they were saved in */
+    for (uint32_t k = 0; k < num_alive; k += 1) {
+        SmartPointer<LifeForm> lf = lives[k];
+        world.space.restore(lf, lf->pos(), [lf](void) { lf->region_resize(); });
+        lf->arrive();
+    }
+
+    world.equeue.clear();
+    vector<Event*> queue;
+    uint32_t num_events = p.get<uint32_t>();
+    for (uint32_t k = 0; k < num_events; k += 1) {
+        Event::Kind kind = Event::find_kind(p.get_string());
+        SimTime t = p.get<SimTime>();
+        uint64_t seq = p.get<uint64_t>();
+        bool active = p.get<uint8_t>() != 0;
+        int32_t owner = p.get<int32_t>();
+        double arg = p.get<double>();
+        if (!p.ok() || kind == nullptr || owner >= (int32_t) lives.size()) {
+            for (Event* e : queue) delete e;
+            return bad("bad event");
+        }
+        queue.push_back(new Event(kind, owner < 0 ? nullptr : &*lives[owner], arg, t, seq));
+        queue.back()->active = active;
+    }
+    for (Event* e : queue) e->in_queue = true;
+    world.equeue.assign(queue);
+
+    vector<Event**> members;
+    for (SmartPointer<LifeForm>& lf : lives) {
+        members.clear();
+        lf->event_members(members);
+        if (p.get<uint32_t>() != members.size()) return bad("bad event members");
+        for (Event** m : members) {
+            int32_t k = p.get<int32_t>();
+            *m = k >= 0 && k < (int32_t) queue.size() ? queue[k] : nullptr;
+        }
+    }
+    if (!p.done()) return bad("truncated");
+
+    /* making the LifeForms drew streams, and counted them as births */
+    world.seed = (unsigned long) seed;
+    world.random = random;
+    world.num_streams = num_streams;
+    world.max_species = max_species;
+    world.species_stats.assign(Species::count(), SpeciesStats());
+    for (const auto& t : totals) {
+        if (t.first.empty()) continue;      // "no species"
+        Species s = Species::intern(t.first);
+        if (s.index() >= world.species_stats.size()) world.species_stats.resize(s.index() + 1);
+        world.species_stats[s.index()] = t.second;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#if !(_Checkpoint_h)
+#define _Checkpoint_h 1
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class World;
+
+/*
+ * Class name: Checkpoint
+ * Description:
+ *  Saves the whole state of a World in a (binary) file, so that a long
+ *  run can be picked up again after a crash, or from any point that was
+ *  saved, in the time it takes to read the file.  A checkpoint holds:
+ *    - the clock, the World's RandomStream and the number of streams it
+ *      has handed out, the species totals and max_species
+ *    - every LifeForm that is alive, or that a pending Event is about:
+ *      its species, its row of all_life, reproduce_time, start_point,
+ *      its RandomStream and handle (see Trace.h), and whatever its
+ *      species saves (save_state)
+ *    - every pending Event (cancelled ones too), in the order of the
+ *      heap: its kind, time, owner and number, and which Event* member
+ *      of its owner points to it
+ *  The QuadTree isn't saved: it is rebuilt from the positions of the
+ *  living LifeForms, and comes out the same (its shape depends only on
+ *  where the objects are).  The events are saved by kind (see Event.h),
+ *  so a World with an Event that was made from a closure can't be saved.
+ *
+ *  save() copies the World into a buffer and returns, the file is
+ *  written by a background thread (to target.tmp, then renamed, so that
+ *  target is always a whole checkpoint).  As with a FrameWriter, if the
+ *  thread falls behind, save() waits for it.
+ *
+ *  A World that is restored goes on exactly as the one that was saved
+ *  would have (as long as both are run by the same program, with the same
+ *  parameters, and the checkpoint was saved between events).  Only the
+ *  graveyard can differ: the dead LifeForms that nothing but a
+ *  SmartPointer kept around aren't saved.
+ *
+ *  Usage:
+ *      Checkpoint c("run.ckpt");
+ *      c.save(world);              // every so often, between events
+ *      ...
+ *      World w;
+ *      Checkpoint::restore(w, "run.ckpt");     // instead of LifeForm::create_life
+ */
+class Checkpoint {
+public:
+    explicit Checkpoint(const std::string& target);
+    ~Checkpoint(void) { close(); }
+
+    bool save(World&);          // false if the World can't be saved
+    void close(void);           // wait for every checkpoint to be written
+    unsigned long saved(void) const { return num_saved; }
+
+    /* fill a new World (with no LifeForms or Events yet) from a checkpoint
+       file.  false (and the World is left empty) if it can't be read */
+    static bool restore(World&, const std::string& file);
+
+private:
+    typedef std::vector<char> Buffer;
+    static const size_t max_pending = 2;
+
+    void run(void);             // the background thread
+
+    std::string target;
+    unsigned long num_saved = 0;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<Buffer> pending; // checkpoints waiting to be written
+    bool closing = false;
+    std::thread worker;
+
+    Checkpoint(const Checkpoint&) = delete;
+    void operator=(const Checkpoint&) = delete;
+};
+
+#endif /* !(_Checkpoint_h) */
@@ -8,17 +8,17 @@
 #include "Event.h"
 #include "ObjInfo.h"
 #include "Params.h"
-#include "Random.h"
+#include "SlabPool.h"
 #include "Window.h"
+#include "World.h"
 
-#ifdef _MSC_VER
-using namespace epl;
-#endif
 using namespace std;
 using String = std::string;
 
 Initializer<Craig> __Craig_initializer;
 
+static const double sight = 20.0;       // how far a Craig looks for food
+
 String Craig::species_name(void) const
 {
     return "Craig";
@@ -26,21 +26,32 @@ String Craig::species_name(void) const
 
 Action Craig::encounter(const ObjInfo& info)
 {
-    if (info.species == species_name()) {
+    if (info.species == species()) {
         /* don't be cannibalistic */
         set_course(info.bearing + M_PI);
         return LIFEFORM_IGNORE;
     }
     else {
         hunt_event->cancel();
-        SmartPointer<Craig> self = SmartPointer<Craig>(this);
-        hunt_event = new Event(0.0, [self](void) { self->hunt(); });
+        hunt_event = new Event(0.0, &on_hunt, this);
         return LIFEFORM_EAT;
     }
 }
 
+#if (SLAB_POOLS)
+void* Craig::operator new(size_t bytes) {
+    return SlabPool<Craig>::the_pool("Craig").allocate(bytes);
+}
+
+void Craig::operator delete(void* p, size_t bytes) {
+    SlabPool<Craig>::the_pool("Craig").release(p, bytes);
+}
+#endif /* SLAB_POOLS */
+
 void Craig::initialize(void) {
     LifeForm::add_creator(Craig::create, "Craig");
+    Event::add_kind(&on_hunt, "Craig::hunt", sight);
+    Event::add_kind(&on_startup, "Craig::startup");
 }
 
 /*
@@ -48,18 +59,20 @@ void Craig::initialize(void) {
  * from inside the constructor!!!!
  * you must wait until the object is actually alive
  */
-Craig::Craig() {
-    SmartPointer<Craig> self = SmartPointer<Craig>(this);
-    new Event(0, [self](void) { self->startup(); });
+Craig::Craig() : hunt_event(nullptr) {
+    new Event(0, &on_startup, this);
 }
 
 Craig::~Craig() {}
 
 void Craig::startup(void) {
-    set_course(drand48() * 2.0 * M_PI);
-    set_speed(2 + 5.0 * drand48());
-    SmartPointer<Craig> self = SmartPointer<Craig>(this);
-    hunt_event = new Event(0, [self](void) { self->hunt(); });
+    /* a Craig that has just been remade by another process (see
+       ShardedWorld.h) is under way already */
+    if (get_speed() == 0.0) {
+        set_course(drand48() * 2.0 * M_PI);
+        set_speed(2 + 5.0 * drand48());
+    }
+    hunt_event = new Event(0, &on_hunt, this);
 }
 
 void Craig::spawn(void) {
@@ -78,25 +91,24 @@ SmartPointer<LifeForm> Craig::create(void) {
 
 
 void Craig::hunt(void) {
-    const String fav_food = "Algae";
+    static const Species fav_food = Species::intern("Algae");
 
     hunt_event = nullptr;
     if (health() == 0.0) { return; } // we died
 
-    ObjList prey = perceive(20.0);
-
+    /* perceive_each does not build a list, but we must not change course
+       while it is still looking, so remember the best bearing for later */
     double best_d = HUGE;
-    for (ObjList::iterator i = prey.begin(); i != prey.end(); ++i) {
-        if ((*i).species == fav_food) {
-            if (best_d > (*i).distance) {
-                set_course((*i).bearing);
-                best_d = (*i).distance;
-            }
+    double best_bearing = 0.0;
+    perceive_each(sight, [&](const ObjInfo& prey) {
+        if (prey.is(fav_food) && best_d > prey.distance) {
+            best_bearing = prey.bearing;
+            best_d = prey.distance;
         }
-    }
+    });
+    if (best_d < HUGE) { set_course(best_bearing); }
 
-    SmartPointer<Craig> self = SmartPointer<Craig>(this);
-    hunt_event = new Event(10.0, [self](void) { self->hunt(); });
+    hunt_event = new Event(10.0, &on_hunt, this);
 
     if (health() >= 4.0) spawn();
 }
@@ -11,12 +11,22 @@ protected:
   void spawn(void);
   void hunt(void);
   void startup(void);
+  static void on_hunt(LifeForm* c, double) { static_cast<Craig*>(c)->hunt(); }
+  static void on_startup(LifeForm* c, double) { static_cast<Craig*>(c)->startup(); }
   Event* hunt_event;
+  void event_members(std::vector<Event**>& out) {
+    LifeForm::event_members(out);
+    out.push_back(&hunt_event);
+  }
 public:
   Craig(void);
   ~Craig(void);
   Color my_color(void) const;   // defines LifeForm::my_color
   static SmartPointer<LifeForm> create(void);
+#if (SLAB_POOLS)
+  static void* operator new(size_t);            // from SlabPool<Craig>
+  static void operator delete(void*, size_t);
+#endif /* SLAB_POOLS */
   virtual std::string species_name(void) const;
   virtual Action encounter(const ObjInfo&);
   friend class Initializer<Craig>;
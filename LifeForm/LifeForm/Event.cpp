@@ -1,100 +1,202 @@
 #include <iostream>
 #include <cassert>
-#include <algorithm>
-#include <queue>
-#include <vector>
+#include <map>
 #include "Params.h"
 #include "Event.h"
+#include "PQueue.h"
+#include "Probe.h"
+#include "LifeForm.h"
+#include "Replay.h"
+#include "Trace.h"
+#include "World.h"
 
 using namespace std;
 
-SimTime Event::_now = 0;
-
-struct EventCompare {
-  bool operator()(const Event* ep1, const Event* ep2) {
-    return ep1->t > ep2->t;     // backwards on purpose so that events 
-                                // are processed in increasing order
-  }
-};
-
-class PQueue {
-	vector<Event*> V;
-public:
-	PQueue(void) {} // normal construction
-	~PQueue(void);
-  
-	void insert(Event* e) {
-		V.push_back(e);
-		push_heap(V.begin(), V.end(), EventCompare());
-	}
-
-	Event* pop_greatest(void) {
-		pop_heap(V.begin(), V.end(), EventCompare());
-		Event* e = V.back();
-		V.pop_back();
-		return e;
-	}
+Event::Event(SimTime delta_time, Handler f, LifeForm* o)
+    : doit(f), world(o ? &o->home() : &World::current()), owner(o) {
+    if (delta_time < min_delta_time) delta_time = min_delta_time;
+    t = world->now + delta_time;
+    seq = world->next_seq ? world->next_seq++ : 0;
+    active = true;
+    insert();
+}
 
-  
-  /*
-   * remove an event from the queue
-   */
-  void remove(Event* e) {
-	  e->cancel();
-  }
-
-  unsigned size(void) const {
-    return V.end() - V.begin();
-  }
-};
+Event::Event(SimTime delta_time, Kind k, LifeForm* o, double a)
+    : Event(delta_time, handler(k, o, a), o) {
+    kind = k;
+    arg = a;
+    if (world->trace) traced = world->trace->scheduled(*this, delta_time);
+}
 
-/* delete all of the events */
-PQueue::~PQueue() {
-  /* this look relies on the events removing themselves from the queue */
-  /* it's slow, but it's simple (and who cares how fast it is, 
-     the program's over by now */
-  while (!V.empty()) {
-    Event* e = V.front();
-    delete e;
-  }
+Event::Event(Kind k, LifeForm* o, double a, SimTime when, uint64_t number)
+    : t(when), doit(handler(k, o, a)), world(o ? &o->home() : &World::current()), owner(o),
+      seq(number), in_queue(false), kind(k), arg(a) {
+    active = true;
 }
 
-PQueue Event::equeue;
+/* the handler holds a reference to the owner, as a closure would */
+Event::Handler Event::handler(Kind k, LifeForm* o, double a) {
+    SmartPointer<LifeForm> keep(o);
+    return [k, keep, o, a](void) { k(o, a); };
+}
 
+Event::Event(Handler f, SimTime when, uint64_t number)
+    : t(when), doit(f), world(&World::current()), owner(nullptr), seq(number) {
+    active = true;
+    insert();
+}
 
 Event::~Event() {
 	assert(!in_queue);
 }
 
+SimTime Event::now(void) {
+	return World::current().now;
+}
+
+#if PERCEIVE_SWEEP
+/*
+ * at the first event of an instant: if it is of a kind that perceives,
+ * the queries of every event of such a kind that is due now are
+ * answered together, when there are at least sweep_min of them
+ */
+void Event::sweep(World& world, const Event* first) {
+	if (world.perceive_sweep.holds()) world.perceive_sweep.clear();
+	if (first->kind == nullptr || perceives(first->kind) == 0.0) return;
+	world.perceive_sweep.skip(world.now);
+
+	vector<pair<Point, double>> circles;
+	auto add = [&circles](const Event* e) {
+		double radius = e->active && e->kind && e->owner ? perceives(e->kind) : 0.0;
+		if (radius > 0.0 && e->owner->is_alive()) circles.push_back(make_pair(e->owner->position(), radius));
+	};
+	add(first);
+	world.equeue.each_at(world.now, add);
+	if (circles.size() >= sweep_min) world.perceive_sweep.sweep(world.space, circles, world.now);
+}
+#endif /* PERCEIVE_SWEEP */
+
 /*
  * simulate until there are no more events to simulate
  */
 void Event::do_next(void) {
-	Event* e = equeue.pop_greatest();
+	PROBE("Event::do_next");
+	World& world = World::current();
+	Event* e = world.equeue.pop_greatest();
 	e->in_queue = false;
-	assert(e->t >= _now);
-	_now = e->t;
+	assert(e->t >= world.now);
+	world.now = e->t;
 #if DEBUG
-	cout << "doing event at time " << _now << endl;
+	cout << "doing event at time " << world.now << endl;
 #endif /* DEBUG */
-	(*e)();
-	delete e;
+#if PERCEIVE_SWEEP
+	if (world.now != world.perceive_sweep.when()) sweep(world, e);
+#endif /* PERCEIVE_SWEEP */
+	if (world.replay) world.replay->check(*e);
+	uint64_t start = world.profile ? Probe::ticks() : 0;
+	if (world.trace) world.trace->run(*e);
+	else (*e)();
+	if (world.profile) world.profile->add(e->kind, Probe::ticks() - start);
+	if (world.keep_done) world.done.push_back(e);  // for a TimeWarp to run again
+	else delete e;
+}
+
+void Event::do_until(SimTime end) {
+	World& world = World::current();
+	while (world.equeue.size() > 0 && world.equeue.next_time() < end) {
+		do_next();
+	}
+	if (world.now < end) world.now = end;
+}
+
+void Event::move_owned(World& from, const unordered_set<const LifeForm*>& owners) {
+	vector<Event*> moving;
+	from.equeue.take([&owners](const Event* e) { return e->owner && owners.count(e->owner) > 0; },
+		moving);
+	for (Event* e : moving) {
+		e->world = &e->owner->home();
+		e->insert();
+	}
+}
+
+/* (deleting an event may destroy its owner, so they are out of the queue first) */
+void Event::drop_owned(World& from, const unordered_set<const LifeForm*>& owners) {
+	vector<Event*> doomed;
+	from.equeue.take([&owners](const Event* e) { return e->owner && owners.count(e->owner) > 0; },
+		doomed);
+	for (Event* e : doomed) {
+		delete e;
+	}
+}
+
+/*
+ * the kinds are registered while the program starts (e.g., by the
+ * Initializer of a species), and only looked up after that
+ */
+struct KindTable {
+    map<string, Event::Kind> by_name;
+    map<Event::Kind, const string*> names;
+    vector<pair<Event::Kind, double>> perceiving;   // (few, and looked up for every event)
+};
+
+static KindTable& kind_table(void) {
+    static KindTable the_real_table;
+    return the_real_table;
+}
+
+void Event::add_kind(Kind k, const string& name, double perceives) {
+    KindTable& table = kind_table();
+    auto i = table.by_name.insert(make_pair(name, k)).first;
+    assert(i->second == k);
+    table.names[k] = &i->first;
+    if (perceives > 0.0) table.perceiving.push_back(make_pair(k, perceives));
+}
+
+Event::Kind Event::find_kind(const string& name) {
+    KindTable& table = kind_table();
+    auto i = table.by_name.find(name);
+    return i == table.by_name.end() ? nullptr : i->second;
+}
+
+const string* Event::kind_name(Kind k) {
+    KindTable& table = kind_table();
+    auto i = table.names.find(k);
+    return i == table.names.end() ? nullptr : i->second;
+}
+
+vector<Event::Kind> Event::all_kinds(void) {
+    vector<Kind> all;
+    for (const auto& k : kind_table().by_name) {
+        all.push_back(k.second);
+    }
+    return all;
+}
+
+double Event::perceives(Kind k) {
+    for (const auto& p : kind_table().perceiving) {
+        if (p.first == k) return p.second;
+    }
+    return 0.0;
+}
+
+void Event::cancelled(void) {
+    if (world->trace) world->trace->cancelled(*this);
 }
 
 unsigned Event::num_events(void) {
-	return equeue.size();
+	return World::current().equeue.size();
 }
 
 void Event::remove(void) {
 	assert(in_queue);
-	equeue.remove(this);
+	world->equeue.remove(this);
 	in_queue = 0;
 }
 
 void Event::insert() {
 	in_queue = true;
-	assert(Event::_now <= t);
-	equeue.insert(this);
+	assert(world->now <= t);
+	world->equeue.insert(this);
 }
 
 
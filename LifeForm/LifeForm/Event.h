@@ -2,14 +2,21 @@
 #define _Event_h 1
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <limits.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "Params.h"
 #include "SimTime.h"            // for the SimTime class
 
-/* necessary forward reference */
+/* necessary forward references */
 class PQueue;
+class World;
+class LifeForm;
 
 /*
  * Class name: Event
@@ -29,6 +36,26 @@ class PQueue;
  *  Events (instances of the derived classes).
  *
  * Implementation:
+ *  Every Event belongs to the World that is current (World::current())
+ *  when it is created, and goes into that World's queue.  now(),
+ *  num_events() and do_next() are about the current World.
+ *
+ *  An Event that is about a LifeForm should name it as its owner.  It
+ *  then goes into the queue of the owner's World instead, and it follows
+ *  the owner if the owner moves to another World (in a TiledWorld,
+ *  LifeForms move between tiles, see move_owned).
+ *
+ *  Events at the same time happen in no particular order, unless the
+ *  World numbers its Events (World::next_seq, a TimeWarp does): then
+ *  they happen in the order of their numbers (seq), so that running the
+ *  same events again (after a rollback) does exactly the same thing.
+ *
+ *  An Event can be made from a Kind instead of a closure: a plain
+ *  function of the owner (or nullptr) and one number, registered under a
+ *  name with add_kind.  Only those Events can be saved in a checkpoint
+ *  (see Checkpoint.h), which names the kind, so that the Event can be
+ *  made again in another run.
+ *
  *  We rely on a class "SimTime" to exist.  Most probably SimTime is a typedef
  *  to either int or double.
  *  If SimTime does not support operator =, then you must comment out the
@@ -36,18 +63,26 @@ class PQueue;
  *
  */
 class Event {
+public:
+    typedef void (*Kind)(LifeForm*, double);
+
 private:
     SimTime t;
     using Handler = std::function<void(void)>;
     Handler doit;
-    static PQueue equeue;         // a priority queue of all events
-    static SimTime _now;
+    World* world;                 // whose queue this event is in
+    LifeForm* owner;              // who the event is about, or nullptr
+    uint64_t seq;                 // breaks ties in time, 0 unless the World numbers its events
     bool in_queue;
+    Kind kind = nullptr;          // what the event does, if it was made from a Kind
+    double arg = 0.0;             // and the number that it is given
+    bool traced = false;          // a species' event that a Trace has recorded
+    void cancelled(void);         // tell the Trace
 
     /* Implementation NOTE:
        If you inline these, you need to include the definition of PQueue
-       in every file that includes Event.h... Since PQueue is based
-       on templates, this is very expensive... (compiling is slow)
+       (and World) in every file that includes Event.h... Since PQueue is
+       based on templates, this is very expensive... (compiling is slow)
        so, I choose not to inline them */
     void insert(void);            // insert this event into the priority queue
     void remove(void);            // remove this event from the priority queue
@@ -57,21 +92,42 @@ public:
     /* interface */
     void operator()(void) { if (active) { doit(); } }
 
-    static SimTime now(void) { return _now; }
+    static SimTime now(void);     // the time in the current World
     static unsigned num_events(void); // the total number of events in the world
     static void do_next(void);    // process the next event
+    static void do_until(SimTime end); // process every event before 'end',
+                                  // then move the clock up to 'end'
+
+    /* move the events in from's queue whose owner is in 'owners' to the
+       queue of the World that the owner is in now */
+    static void move_owned(World& from, const std::unordered_set<const LifeForm*>& owners);
+    /* delete them instead, without running them (when the owners have
+       moved to another process, see ShardedWorld.h) */
+    static void drop_owned(World& from, const std::unordered_set<const LifeForm*>& owners);
+
+
+    /* register a Kind under a (unique) name, and find it again.  A kind
+       whose events perceive (e.g. a hunt) says how far, and the queries
+       of the events of such kinds that are due at one instant are
+       answered together (see PerceiveSweep.h) */
+    static void add_kind(Kind, const std::string&, double perceives = 0.0);
+    static Kind find_kind(const std::string&);      // nullptr if there is none
+    static const std::string* kind_name(Kind);      // nullptr if it isn't registered
+    static std::vector<Kind> all_kinds(void);       // in the order of their names
+    static double perceives(Kind);                  // 0.0 if its events don't perceive
 
 
   /* constructors and destructors */
-    Event(SimTime delta_time, Handler f) : doit(f) {
-        if (delta_time < min_delta_time) delta_time = min_delta_time;
-        t = _now + delta_time;
-        active = true;
-        insert();
-    }
+    Event(SimTime delta_time, Handler f, LifeForm* owner = nullptr);
+    Event(SimTime delta_time, Kind, LifeForm* owner = nullptr, double arg = 0.0);
     ~Event(void);
 
-    void cancel(void) { if (this) active = false; }
+    void cancel(void) {
+        if (this) {
+            if (traced && active) cancelled();
+            active = false;
+        }
+    }
     bool is_active(void) const { return this && active; }
 
 private:
@@ -79,8 +135,47 @@ private:
     Event(const Event& e) = delete;
     void operator=(const Event&) = delete;
 
-    /* The EventCompare class is used in Event.cc to implement the Event Queue */
+    /* for TimeWarp: an event at exactly 'when', numbered 'seq', in the
+       current World */
+    Event(Handler f, SimTime when, uint64_t seq);
+
+    /* for Checkpoint: an event of a kind at exactly 'when', that is not in
+       a queue yet */
+    Event(Kind, LifeForm* owner, double arg, SimTime when, uint64_t seq);
+    static Handler handler(Kind, LifeForm* owner, double arg);
+
+#if PERCEIVE_SWEEP
+    static void sweep(World&, const Event* first);  // see do_next
+#endif /* PERCEIVE_SWEEP */
+
+    /* The EventCompare class is used in PQueue.h to implement the Event Queue */
     friend struct EventCompare;
+    friend class PQueue;
+    friend class TimeWarp;
+    friend class Checkpoint;
+    friend class Trace;
+    friend class Replay;
+    friend class Puppet;
+};
+
+/*
+ * how many events of each kind a World has run, and how many ticks of
+ * the time stamp counter (see Probe::ticks) they took, if the World has
+ * a profile (e.g., in a benchmark).  Events made from closures are
+ * counted under nullptr
+ */
+struct EventProfile {
+    struct Count {
+        unsigned long events = 0;
+        uint64_t ticks = 0;
+    };
+    std::unordered_map<Event::Kind, Count> kinds;
+
+    void add(Event::Kind k, uint64_t ticks) {
+        Count& c = kinds[k];
+        c.events += 1;
+        c.ticks += ticks;
+    }
 };
 
 #endif /* !(_Event_h) */
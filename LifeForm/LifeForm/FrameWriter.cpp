@@ -0,0 +1,144 @@
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "FrameWriter.h"
+
+using namespace std;
+
+FrameWriter::FrameWriter(const string& t, int w, int h)
+    : target(t), width(w), height(h)
+{
+    if (!target.empty() && target[0] == '|') {
+        mode = PIPE;
+        signal(SIGPIPE, SIG_IGN);           // a command that quits gives EPIPE instead
+        out = popen(target.c_str() + 1, "w");
+    }
+    else if (target.find('%') != string::npos) {
+        mode = SEQUENCE;                    // each file is opened as it is written
+        if (!is_pattern(target)) {
+            cerr << "FrameWriter: " << target << " needs exactly one integer conversion"
+                 << " (e.g. %05d) for the frame number, and %% for any other %\n";
+            good = false;
+            return;
+        }
+    }
+    else {
+        mode = STREAM;
+        out = fopen(target.c_str(), "wb");
+    }
+    if (mode != SEQUENCE && out == nullptr) {
+        cerr << "FrameWriter: cannot open " << target << "\n";
+        good = false;
+        return;
+    }
+    worker = thread([this](void) { run(); });
+}
+
+void FrameWriter::write(const unsigned char* rgb) {
+    if (!good) return;
+    size_t bytes = (size_t) width * (size_t) height * 3;
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this](void) { return pending.size() < max_pending; });
+
+    Frame f;
+    if (!spare.empty()) {
+        f.swap(spare.back());
+        spare.pop_back();
+    }
+    f.assign(rgb, rgb + bytes);
+    pending.push_back(std::move(f));
+    num_frames += 1;
+    changed.notify_all();
+}
+
+void FrameWriter::close(void) {
+    if (!worker.joinable()) return;
+    {
+        lock_guard<mutex> guard(lock);
+        closing = true;
+        changed.notify_all();
+    }
+    worker.join();
+    if (out) {
+        if (mode == PIPE) pclose(out);
+        else if (fclose(out) != 0 && good) {
+            cerr << "FrameWriter: cannot write " << target << ": " << strerror(errno) << "\n";
+            good = false;
+        }
+        out = nullptr;
+    }
+}
+
+/*
+ * true if the name has exactly one conversion, and it is of an int
+ * (flags, width and precision allowed, no '*' and no length modifier)
+ */
+bool FrameWriter::is_pattern(const string& name) {
+    int conversions = 0;
+    for (size_t k = 0; k < name.size(); k++) {
+        if (name[k] != '%') continue;
+        k += 1;
+        if (k < name.size() && name[k] == '%') continue;
+        while (k < name.size() && strchr("-+ #0", name[k])) k++;
+        while (k < name.size() && isdigit((unsigned char) name[k])) k++;
+        if (k < name.size() && name[k] == '.') {
+            k += 1;
+            while (k < name.size() && isdigit((unsigned char) name[k])) k++;
+        }
+        if (k == name.size() || !strchr("diouxX", name[k])) return false;
+        conversions += 1;
+    }
+    return conversions == 1;
+}
+
+/* write frames as they arrive, until close is called and nothing is left */
+void FrameWriter::run(void) {
+    unsigned long index = 0;
+    for (;;) {
+        Frame f;
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this](void) { return closing || !pending.empty(); });
+            if (pending.empty()) return;    // closing, and all written
+            f.swap(pending.front());
+            pending.pop_front();
+            changed.notify_all();           // there is room in pending now
+        }
+
+        if (good && !encode(f, index)) good = false;  // (the rest are dropped)
+        index += 1;
+
+        lock_guard<mutex> guard(lock);
+        spare.push_back(std::move(f));
+    }
+}
+
+bool FrameWriter::encode(const Frame& f, unsigned long index) {
+    if (mode == SEQUENCE) {
+        vector<char> name(target.size() + 32);
+        snprintf(name.data(), name.size(), target.c_str(), (int) index);  // (is_pattern)
+        FILE* file = fopen(name.data(), "wb");
+        bool written = file != nullptr
+            && fprintf(file, "P6\n%d %d\n255\n", width, height) > 0
+            && fwrite(f.data(), 1, f.size(), file) == f.size();
+        if (file != nullptr && fclose(file) != 0) written = false;
+        if (!written) {
+            cerr << "FrameWriter: cannot write " << name.data() << ": " << strerror(errno)
+                 << " (no more frames are saved)\n";
+        }
+        return written;
+    }
+    if (fwrite(f.data(), 1, f.size(), out) == f.size()) return true;
+    if (mode == PIPE && errno == EPIPE) {
+        cerr << "FrameWriter: " << target.substr(1) << " has stopped reading frames\n";
+    }
+    else {
+        cerr << "FrameWriter: cannot write " << target << ": " << strerror(errno)
+             << " (no more frames are saved)\n";
+    }
+    return false;
+}
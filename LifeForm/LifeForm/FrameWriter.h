@@ -0,0 +1,74 @@
+#if !(_FrameWriter_h)
+#define _FrameWriter_h 1
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Class name: FrameWriter
+ * Description:
+ *  Saves the frames drawn on a Canvas, so that a run without a window
+ *  (NO_WINDOW) can still be watched afterwards.  The target says where
+ *  the frames go:
+ *
+ *      "frames/f%05d.ppm"  one PPM image per frame, the frame number is
+ *                          formatted into the name with printf (the name
+ *                          must have exactly one integer conversion, and
+ *                          any other % written as %%)
+ *      "|command"          a raw RGB stream (width * height * 3 bytes per
+ *                          frame) piped to the command, e.g.
+ *                          "|ffmpeg -f rawvideo -pix_fmt rgb24 -s 500x500 -i - run.mp4"
+ *      "run.rgb"           the same raw RGB stream, written to a file
+ *
+ *  write() copies the frame and returns; the encoding and the disk (or
+ *  pipe) I/O are done by a background thread.  If that thread falls more
+ *  than max_pending frames behind, write() waits for it, so a slow disk
+ *  slows the simulation down instead of filling up memory.
+ *
+ *  close() (or the destructor) waits for every frame to be written.
+ *  If a frame can't be written (e.g., the disk is full), that is reported
+ *  once and the rest are dropped; a command that stops reading the pipe
+ *  simply ends the recording (the simulation goes on).
+ */
+class FrameWriter {
+public:
+    FrameWriter(const std::string& target, int width, int height);
+    ~FrameWriter(void) { close(); }
+
+    bool ok(void) const { return good; }    // false if the target could not be opened,
+                                            // or writing to it has failed
+    void write(const unsigned char* rgb);   // queue one width * height * 3 byte frame
+    void close(void);
+    unsigned long frames(void) const { return num_frames; }
+
+private:
+    typedef std::vector<unsigned char> Frame;
+    enum Mode { SEQUENCE, PIPE, STREAM };
+    static const size_t max_pending = 4;
+
+    void run(void);                         // the background thread
+    bool encode(const Frame&, unsigned long);  // false if it couldn't be written
+    static bool is_pattern(const std::string&); // one integer conversion, see above
+
+    std::string target;
+    Mode mode;
+    int width, height;
+    FILE* out = nullptr;
+    std::atomic<bool> good{ true };
+    unsigned long num_frames = 0;           // frames given to write
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<Frame> pending;              // frames waiting to be written
+    std::vector<Frame> spare;               // written frames, recycled by write
+    bool closing = false;
+    std::thread worker;
+};
+
+#endif /* !(_FrameWriter_h) */
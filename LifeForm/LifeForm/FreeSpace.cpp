@@ -0,0 +1,45 @@
+#include <cmath>
+
+#include "FreeSpace.h"
+
+using namespace std;
+
+FreeSpace::FreeSpace(const Point& c, double s, double clearance)
+    : corner(c), side(s), cell(clearance + Point::tolerance)
+{
+    n = (int) ceil(side / cell);
+    if (n < 1) n = 1;
+    marked.assign((size_t) (n + 2) * (n + 2), 0);
+}
+
+/*
+ * a point more than a cell outside the square is more than the clearance
+ * from every point in it
+ */
+void FreeSpace::occupy(const Point& p)
+{
+    int i = index(p.xpos, corner.xpos), j = index(p.ypos, corner.ypos);
+    if (i < 0 || i > n + 1 || j < 0 || j > n + 1) return;
+    marked[at(i, j)] = 1;
+}
+
+bool FreeSpace::is_free(uint32_t c) const
+{
+    const int row = n + 2;
+    for (int dj = -row; dj <= row; dj += row) {
+        for (int di = -1; di <= 1; di += 1) {
+            if (marked[c + dj + di]) return false;
+        }
+    }
+    return true;
+}
+
+void FreeSpace::list(void)
+{
+    listed = true;
+    for (int j = 1; j <= n; j += 1) {
+        for (int i = 1; i <= n; i += 1) {
+            if (is_free(at(i, j))) free.push_back(at(i, j));
+        }
+    }
+}
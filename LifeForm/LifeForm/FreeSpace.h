@@ -0,0 +1,88 @@
+#if !(_FreeSpace_h)
+#define _FreeSpace_h 1
+
+#include <cassert>              // (Point.h asserts)
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Point.h"
+
+/*
+ * Class name: FreeSpace
+ * Description:
+ *  An occupancy grid over a square of the world, for finding places that
+ *  are farther than some clearance from everything in it (e.g. where a
+ *  spore can go without an encounter).  The square is cut into cells a
+ *  little larger than the clearance, with a margin of one cell around
+ *  it, and every point given to occupy marks its cell.  A point in a cell
+ *  whose 3x3 block of cells is unmarked is more than the clearance away
+ *  from every occupied point, so take picks one of those cells at random
+ *  and a point in it, and occupies that point in turn.
+ *
+ *  Unlike drawing points until one is clear, which slows without bound as
+ *  the square fills, the work is bounded: one pass over the cells the
+ *  first time take is called, then every cell found to be no longer
+ *  free is dropped from the list for good.  take says false only when no
+ *  free cell is left (there may still be room between cells, but little).
+ */
+class FreeSpace {
+public:
+    /* the square from corner to corner + (side, side) */
+    FreeSpace(const Point& corner, double side, double clearance);
+
+    void occupy(const Point&);  // (points well outside the square don't matter)
+
+    /* a free place in the square, chosen with uniform() (in [0, 1)),
+       put in where and occupied; false if there is none */
+    template <typename Uniform>
+    bool take(Uniform uniform, Point& where) {
+        return take(uniform, where, [](const Point&) { return true; });
+    }
+
+    /* the same, but only a place that accept(place) is true of (a cell
+       whose place isn't accepted is given up) */
+    template <typename Uniform, typename Accept>
+    bool take(Uniform uniform, Point& where, Accept accept);
+
+    size_t free_cells(void) const { return free.size(); }  // (an upper bound, once taking)
+
+private:
+    Point corner;
+    double side;
+    double cell;                // the side of a cell
+    int n;                      // cells along a side of the square
+    std::vector<uint8_t> marked;        // (n + 2) x (n + 2), with the margin
+    std::vector<uint32_t> free;         // cells that were free when last looked at
+    bool listed = false;        // whether free has been made
+
+    int index(double x, double from) const { return (int) std::floor((x - from) / cell) + 1; }
+    uint32_t at(int i, int j) const { return (uint32_t) (j * (n + 2) + i); }
+    bool is_free(uint32_t c) const;
+    void list(void);
+};
+
+template <typename Uniform, typename Accept>
+bool FreeSpace::take(Uniform uniform, Point& where, Accept accept) {
+    if (!listed) list();
+    while (!free.empty()) {
+        size_t k = (size_t) (uniform() * free.size());
+        if (k >= free.size()) k = free.size() - 1;
+        uint32_t c = free[k];
+        free[k] = free.back();
+        free.pop_back();
+        if (!is_free(c)) continue;
+
+        /* (the last cell along a side may stick out of the square) */
+        int i = (int) (c % (n + 2)) - 1, j = (int) (c / (n + 2)) - 1;
+        double w = side - i * cell, h = side - j * cell;
+        where.xpos = corner.xpos + i * cell + uniform() * (w < cell ? w : cell);
+        where.ypos = corner.ypos + j * cell + uniform() * (h < cell ? h : cell);
+        if (!accept(where)) continue;
+        marked[c] = 1;
+        return true;
+    }
+    return false;
+}
+
+#endif /* !(_FreeSpace_h) */
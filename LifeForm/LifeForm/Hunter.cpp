@@ -0,0 +1,87 @@
+#include "Hunter.h"
+
+#if (BEHAVIORS)
+#include <cmath>
+#include <string>
+
+#include "CraigUtils.h"
+#include "Event.h"
+#include "ObjInfo.h"
+#include "Params.h"
+#include "SlabPool.h"
+
+using namespace std;
+
+Initializer<Hunter> __Hunter_initializer;
+
+string Hunter::species_name(void) const
+{
+    return "Hunter";
+}
+
+Action Hunter::encounter(const ObjInfo& info)
+{
+    if (info.species == species()) {
+        /* don't be cannibalistic */
+        set_course(info.bearing + M_PI);
+        return LIFEFORM_IGNORE;
+    }
+    else {
+        wake();                 // hunt again at once
+        return LIFEFORM_EAT;
+    }
+}
+
+#if (SLAB_POOLS)
+void* Hunter::operator new(size_t bytes) {
+    return SlabPool<Hunter>::the_pool("Hunter").allocate(bytes);
+}
+
+void Hunter::operator delete(void* p, size_t bytes) {
+    SlabPool<Hunter>::the_pool("Hunter").release(p, bytes);
+}
+#endif /* SLAB_POOLS */
+
+void Hunter::initialize(void) {
+    LifeForm::add_creator(Hunter::create, "Hunter");
+}
+
+void Hunter::spawn(void) {
+    SmartPointer<Hunter> child = new Hunter;
+    reproduce(child);
+}
+
+Color Hunter::my_color(void) const {
+    return MAGENTA;
+}
+
+SmartPointer<LifeForm> Hunter::create(void) {
+    return new Hunter;
+}
+
+Behavior Hunter::behave(void) {
+    static const Species fav_food = Species::intern("Algae");
+
+    /* a Hunter that has just been remade by another process (see
+       ShardedWorld.h) is under way already */
+    if (get_speed() == 0.0) {
+        set_course(drand48() * 2.0 * M_PI);
+        set_speed(2 + 5.0 * drand48());
+    }
+    while (health() > 0.0) {
+        const ObjList& around = co_await perceive(20.0);
+        double best_d = HUGE;
+        double best_bearing = 0.0;
+        for (const ObjInfo& prey : around) {
+            if (prey.is(fav_food) && best_d > prey.distance) {
+                best_bearing = prey.bearing;
+                best_d = prey.distance;
+            }
+        }
+        if (best_d < HUGE) { set_course(best_bearing); }
+        if (health() >= 4.0) spawn();
+        co_await sleep(10.0);
+    }
+}
+
+#endif /* BEHAVIORS */
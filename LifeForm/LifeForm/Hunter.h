@@ -0,0 +1,34 @@
+#if !(_Hunter_h)
+#define _Hunter_h 1
+
+#include "Behavior.h"
+
+#if (BEHAVIORS)
+#include <memory>
+#include "LifeForm.h"
+#include "Init.h"
+
+/*
+ * Craig (see Craig.cpp), written as a Behavior: it hunts the same way,
+ * in one loop instead of hunt events that schedule one another
+ */
+class Hunter : public Actor {
+protected:
+  static void initialize(void);
+  Behavior behave(void);
+  void spawn(void);
+public:
+  Hunter(void) {}
+  Color my_color(void) const;   // defines LifeForm::my_color
+  static SmartPointer<LifeForm> create(void);
+#if (SLAB_POOLS)
+  static void* operator new(size_t);            // from SlabPool<Hunter>
+  static void operator delete(void*, size_t);
+#endif /* SLAB_POOLS */
+  virtual std::string species_name(void) const;
+  virtual Action encounter(const ObjInfo&);
+  friend class Initializer<Hunter>;
+};
+
+#endif /* BEHAVIORS */
+#endif /* !(_Hunter_h) */
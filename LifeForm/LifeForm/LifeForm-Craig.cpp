@@ -2,6 +2,8 @@
 #include <iostream>
 #include <iterator>
 #include <math.h>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdio.h>
 #include <string>
@@ -15,16 +17,19 @@
 #include "ObjInfo.h"
 #include "CraigUtils.h"
 #include "QuadTree.h"
+#include "NearbyCache.h"
 #include "LifeForm.h"
 #include "Algae.h"
+#include "FreeSpace.h"
 #include "Random.h"
+#include "SlabPool.h"
+#include "MetricsSink.h"
+#include "Probe.h"
+#include "Trace.h"
+#include "World.h"
 
-#if defined (_MSC_VER)
-using namespace epl;
-#endif
 using namespace std;
 using String = std::string;
-double MAX_SIMULATION_TIME = 50000.0;
 
 /*
  * Implementation NOTE:
@@ -46,21 +51,17 @@ LFCreatorTable& LifeForm::istream_creators()
     return the_real_table;
 }
 
-QuadTree<SmartPointer<LifeForm>> LifeForm::space(0.0, 0.0, grid_max, grid_max);
-Canvas LifeForm::win(win_x_size, win_y_size);
-
-std::vector<LifeForm*> LifeForm::all_life;
-
-LifeForm::LifeForm(void) {
-    energy = start_energy;
-    course = speed = 0.0;         // stationary
-    pos = Point(0, 0);
-    is_alive = false;
-    update_time = Event::now();
+LifeForm::LifeForm(void) : world(&World::current()), all_life(&world->all_life) {
+    vector_pos = all_life->push_back(this);
+    all_life->energy[vector_pos] = start_energy;
+    course() = speed() = 0.0;         // stationary
+    pos() = Point(0, 0);              // not alive until come_alive is called
+    update_time() = Event::now();
     reproduce_time = 0.0;
+    random = world->new_stream();
+    handle = world->last_stream();
     border_cross_event = nullptr;
-    vector_pos = all_life.size();
-    all_life.push_back(this);
+    if (world->trace) world->trace->made(*this);
 }
 
 
@@ -69,14 +70,12 @@ LifeForm::~LifeForm(void) {
     cout << "death event\n";
 #endif /* DEBUG */
 
-    assert(!is_alive);
-    assert(all_life[vector_pos] == this);
+    assert(!is_alive());
+    assert((*all_life)[vector_pos] == this);
 
-    /* remove from all_life list */
-    LifeForm* last = all_life.back();
-    all_life[vector_pos] = last;
-    last->vector_pos = vector_pos;
-    all_life.pop_back();
+    /* remove from all_life list (we are in the graveyard) */
+    LifeForm* last = all_life->remove(vector_pos);
+    if (last) { last->vector_pos = vector_pos; }
 }
 
 
@@ -84,14 +83,38 @@ String LifeForm::player_name(void) const {
     return species_name();
 }
 
+/* species_name() is virtual and builds a new string each time, so we
+   only ever call it once per object */
+Species LifeForm::species(void) const {
+    if (my_species == Species()) {
+        my_species = Species::intern(species_name());
+    }
+    return my_species;
+}
+
+SpeciesStats& LifeForm::stats(void) {
+    Species::Id k = species().index();
+    if (k >= world->species_stats.size()) world->species_stats.resize(Species::count());
+    return world->species_stats[k];
+}
+
 
 
 void LifeForm::create_life(void)
 {
-    SmartPointer<LifeForm> obj;
-
     if (testMode) { runTests(); return; }
 
+    populate();
+    redisplay_all();
+    World::current().win.display();
+}
+
+/* place the LifeForms listed in config.test in the current World */
+void LifeForm::populate(void)
+{
+    World* world = &World::current();
+    SmartPointer<LifeForm> obj;
+
     string line;
     ifstream inFile;
 #if defined (_MSC_VER)
@@ -103,43 +126,52 @@ void LifeForm::create_life(void)
     while (!inFile.eof())
     {
         getline(inFile, line);
-        istringstream iss(line);
+        istringstream iss(line);
         vector<string> tokens{ istream_iterator<string>{iss}, istream_iterator<string>{} };
 
-        if (tokens.size() == 2)
+        if (tokens.size() == 2 || tokens.size() == 5)
         {
             IstreamCreator factory_fun = (istream_creators())[tokens[0]];
             bool first = true;
             int numCreated = stoi(tokens[1]);
+            /* "name count x y radius" puts them in that circle instead */
+            bool cluster = tokens.size() == 5;
+            Point center = cluster ? Point(stod(tokens[2]), stod(tokens[3])) : Point(0, 0);
+            double radius = cluster ? stod(tokens[4]) : 0.0;
             for (int i = 0; i < numCreated; i++) {
                 obj = factory_fun();
                 SmartPointer<LifeForm> nearest;
                 do {
-                    obj->pos.ypos = drand48() * grid_max * 0.75 + grid_max / 8.0;
-                    obj->pos.xpos = drand48() * grid_max * 0.75 + grid_max / 8.0;
+                    if (cluster) {
+                        double angle = world->drand48() * 2.0 * M_PI;
+                        double d = sqrt(world->drand48()) * radius;
+                        obj->pos() = center + Point(cos(angle) * d, sin(angle) * d);
+                    }
+                    else {
+                        obj->pos().ypos = world->drand48() * grid_max * 0.75 + grid_max / 8.0;
+                        obj->pos().xpos = world->drand48() * grid_max * 0.75 + grid_max / 8.0;
+                    }
                     if (first) {
                         nearest = nullptr;
                         first = false;
                     }
                     else {
-                        nearest = space.closest(obj->pos);
+                        nearest = world->space.closest(obj->pos());
                     }
                 } while (nearest
                     && nearest->position().distance(obj->position()) <= encounter_distance);
-                obj->start_point = obj->pos;
-                space.insert(obj, obj->pos, [obj]() { obj->region_resize(); });
-                (void) new Event(age_frequency, [obj](void) { obj->age(); });
-                obj->is_alive = true;
+                obj->start_point = obj->pos();
+                world->space.insert(obj, obj->pos(), [obj]() { obj->region_resize(); });
+                (void) new Event(age_frequency, &on_age, &*obj);
+                obj->come_alive();
             }
         }
     }
-
-    redisplay_all();
-    win.display();
 }
 
 void LifeForm::add_creator(IstreamCreator f, const String& s) {
     (istream_creators())[s] = f;
+    Species::intern(s);
 }
 
 int LifeForm::scale_x(double x) {
@@ -158,7 +190,7 @@ void LifeForm::print(void) const {
 }
 
 void LifeForm::print_position(void) const {
-    cout << "(" << pos.xpos << "," << pos.ypos << ")";
+    cout << "(" << position().xpos << "," << position().ypos << ")";
 }
 
 
@@ -166,10 +198,10 @@ void LifeForm::display(void) const
 {
 #if DEBUG
     cout << "drawing LF at";
-    cout << "(" << pos.xpos << "," << pos.ypos << ")";
+    cout << "(" << position().xpos << "," << position().ypos << ")";
 #endif /* DEBUG */
-    win.set_color(my_color());
-    draw(scale_x(pos.xpos), scale_y(pos.ypos));
+    world->win.set_color(my_color());
+    draw(scale_x(position().xpos), scale_y(position().ypos));
 #if DEBUG
     cout << endl;
 #endif /* DEBUG */
@@ -184,104 +216,195 @@ struct RankCompare {
 
 
 void LifeForm::redisplay_all(void) {
-    typedef map<String, double> SpeciesHT;
-    SpeciesHT species_table;
-    static int max_species = 0; // the maximum number of species ever.
+    PROBE("LifeForm::redisplay_all");
+    World* world = &World::current();
+    LifeFormState* all_life = &world->all_life;
 
-    win.clear();
-    uint32_t num_life = 0;
-    for (LifeForm* k : all_life) {
-        if (k->is_alive) {
-            num_life += 1;
-            k->display();
-            String name = k->player_name();
-            name = name.substr(0, name.find(':'));
-            if (species_table.find(name) == species_table.end()) {
-                species_table[name] = 0.0;
-            }
-            species_table[name] += k->energy;
+    if (live_order != ANY_ORDER) { sort_living(live_order); }
+
+    /* bring everybody up to date so the frame shows where they are now */
+    advance_all();
 
-            /* uncomment the next line to get accurate graphics at the expense
-                 of slowing down the simulator */
-                 //      k->update_position();
+    if (world->win.watched()) {     // (drawing what nobody sees is a waste)
+        world->win.clear();
+        for (LifeForm* k : all_life->living()) {
+            k->display();
         }
+        world->win.flush();
     }
-    win.flush();
+
+    report(*world, all_life->size(), world->equeue.size());
+}
+
+/*
+ * num_objects (every LifeForm, alive or in the graveyard) and num_events
+ * are passed in, because a TiledWorld reports for all of its tiles at
+ * once, from a World that only holds their totals (see TiledWorld.h)
+ */
+void LifeForm::report(World& world, uint32_t num_objects, unsigned num_events) {
+    int& max_species = world.max_species;
 
 #if (SPECIES_SUMMARY)
-    cout << "\n\n\n";
-    cout << "At Time " << Event::now()
-        << " there are " << num_life << " / " << all_life.size() << " total life forms, ";
-    int count = 0;
-    vector<Rank> rankings;
-    for (const auto& i : species_table) {
-        rankings.push_back(Rank(i.first, i.second));
-        count += 1;
+    /* the summary comes from world.species_stats, so it costs O(species),
+       not O(all the life forms ever created) */
+    typedef map<String, double> SpeciesHT;
+    SpeciesHT species_table;
+    uint32_t num_life = 0;
+    for (Species::Id k = 0; k < world.species_stats.size(); k += 1) {
+        const SpeciesStats& stats = world.species_stats[k];
+        if (stats.alive == 0) continue;
+        num_life += stats.alive;
+        const String& full_name = Species::at(k).name();
+        String name = full_name.substr(0, full_name.find(':'));
+        species_table[name] += stats.energy;
     }
-    cout << "and " << count << " distinct species\n";
-    cout << "There are " << Event::num_events()
-        << " events (" << (double)Event::num_events()
-        / (double)num_life << " events per life form)\n";
 
+    int count = (int) species_table.size();
     if (count > max_species) { max_species = count; }
-    sort(rankings.begin(), rankings.end(), RankCompare());
-    int specs = 0;
-
-    for (const Rank& best : rankings) {
-        cout << "Species: " << best.first << " has total of "
-            << best.second << " energy\n";
-        specs += 1;
-        if (specs >= max_species / 2) {  // draw line to indicate winners/losers
-            cout << "----------------------------------------";
-            cout << "----------------------------------------\n";
-            specs = -specs; // make sure the line is drawn only once
+
+    if (world.metrics) {
+        world.metrics->begin_record(world.now, num_life, num_events);
+        for (Species::Id k = 1; k < world.species_stats.size(); k += 1) {
+            if (world.species_stats[k].births > 0) {
+                world.metrics->add_species(Species::at(k).name(), world.species_stats[k]);
+            }
         }
+        world.metrics->end_record();
+    }
+    else {
+        /* several Worlds may print at once, so each summary is written
+           in one piece, with the World's id */
+        ostringstream out;
+        out << "\n\n\n";
+        if (world.id > 0) out << "World " << world.id << ": ";
+        out << "At Time " << world.now
+            << " there are " << num_life << " / " << num_objects << " total life forms, ";
+        vector<Rank> rankings;
+        for (const auto& i : species_table) {
+            rankings.push_back(Rank(i.first, i.second));
+        }
+        out << "and " << count << " distinct species\n";
+        out << "There are " << num_events
+            << " events (" << (double)num_events
+            / (double)num_life << " events per life form)\n";
+
+        sort(rankings.begin(), rankings.end(), RankCompare());
+        int specs = 0;
+
+        for (const Rank& best : rankings) {
+            out << "Species: " << best.first << " has total of "
+                << best.second << " energy\n";
+            specs += 1;
+            if (specs >= max_species / 2) {  // draw line to indicate winners/losers
+                out << "----------------------------------------";
+                out << "----------------------------------------\n";
+                specs = -specs; // make sure the line is drawn only once
+            }
+        }
+
+#if (PERCEIVE_CACHE)
+        out << "Perceive cache: " << world.perceive_cache.hits() << " hits, "
+            << world.perceive_cache.misses() << " misses ("
+            << 100.0 * world.perceive_cache.hit_rate() << "% hit rate)\n";
+#endif /* PERCEIVE_CACHE */
+
+
+#if (SLAB_POOLS)
+        for (const SlabPoolBase* pool : SlabPoolBase::all()) {
+            out << "Pool: " << pool->name() << " has " << pool->live()
+                << " objects (peak " << pool->peak() << ") in "
+                << pool->slabs() << " slabs\n";
+        }
+#endif /* SLAB_POOLS */
+
+        static mutex print_lock;
+        lock_guard<mutex> guard(print_lock);
+        cout << out.str();
     }
 
     if ((termination_strategy == RUN_TILL_HALF_EXTINCT && count <= max_species / 2)
         || (termination_strategy == RUN_TILL_ONE_SPECIES_LEFT && count <= 2)
-        || Event::now() > MAX_SIMULATION_TIME) {
+        || world.now > world.max_time) {
         // abort the simulation
-        cout << "\t!!Simulation Complete at time " << Event::now() << " !!\n";
+        if (world.id > 0) cout << "World " << world.id << ": ";
+        cout << "\t!!Simulation Complete at time " << world.now << " !!\n";
         //cout << "hit CTRL-C to stop\n";  // uncomment if you want to see the
         //sleep(1000);                     // final state of the graphics display
-        exit(0);
+        world.stop();
     }
 #endif /* SPECIES_SUMMARY */
 }
 
 void LifeForm::draw(int x, int y) const
 {
-    win.draw_rectangle(x, y, x + 4, y + 4);
+    world->win.draw_rectangle(x, y, x + 4, y + 4);
 }
 
 void LifeForm::clear_screen(void)
 {
-    win.clear();
+    World::current().win.clear();
 }
 
-
 void Algae::create_spontaneously(void)
 {
-    SmartPointer<Algae> a = new Algae;
-    SmartPointer<LifeForm> nearest;
-    do {
-        a->pos.ypos = drand48() * grid_max * 0.75 + grid_max / 8.0;
-        a->pos.xpos = drand48() * grid_max * 0.75 + grid_max / 8.0;
-        nearest = space.closest(a->pos);
-    } while (nearest && nearest->position().distance(a->position())
-        <= encounter_distance);
-
-    a->start_point = a->pos;
-    space.insert(a, a->pos,
-        [a](void) { a->region_resize(); });
-    a->is_alive = true;
+    create_spontaneously(algae_spores);
+}
+
+/*
+ * count spores, each more than encounter_distance from everything.  they
+ * try random places first, as a spore always did; once one has tried
+ * spore_tries places in vain (or if the batch is large), the rest are
+ * placed with a FreeSpace, which takes bounded work however crowded the
+ * world is.  the spores then go into the QuadTree together
+ */
+void Algae::create_spontaneously(unsigned count)
+{
+    PROBE("Algae::create_spontaneously");
+    World* world = &World::current();
+    const Point corner(grid_max / 8.0, grid_max / 8.0);
+    const double side = grid_max * 0.75;
+    vector<Point> spots;
+    unique_ptr<FreeSpace> free;
+
+    while (spots.size() < count) {
+        Point p;
+        bool found = false;
+        for (unsigned k = 0; !free && count <= spore_tries && k < spore_tries && !found; k += 1) {
+            p.ypos = world->drand48() * grid_max * 0.75 + grid_max / 8.0;
+            p.xpos = world->drand48() * grid_max * 0.75 + grid_max / 8.0;
+            /* (the nursery of a ShardedWorld is empty between ticks) */
+            found = world->space.empty()
+                || world->space.closest(p)->position().distance(p) > encounter_distance;
+            for (const Point& s : spots) found = found && s.distance(p) > encounter_distance;
+        }
+        if (!found && !free) {
+            free.reset(new FreeSpace(corner, side, encounter_distance));
+            Point middle(grid_max / 2.0, grid_max / 2.0);
+            world->space.visit_within(middle, side + encounter_distance,
+                [&free](const SmartPointer<LifeForm>&, const Point& at) { free->occupy(at); });
+            for (const Point& s : spots) free->occupy(s);
+        }
+        if (!found && !free->take([world](void) { return world->drand48(); }, p)) break;
+        spots.push_back(p);
+    }
+
+    vector<pair<SmartPointer<LifeForm>, Point>> spores;
+    for (const Point& p : spots) {
+        /* (by its creator, so that a Replay can play it) */
+        SmartPointer<LifeForm> a = istream_creators()["Algae"]();
+        a->pos() = p;
+        a->start_point = p;
+        spores.push_back(make_pair(a, p));
+    }
+    world->space.insert_all(spores,
+        [](const SmartPointer<LifeForm>& a) { a->region_resize(); });
+    for (auto& s : spores) s.first->come_alive();
 }
 
 
 void LifeForm::die(void)
 {
-    if (!is_alive) return;        // already called.
+    if (!is_alive()) return;        // already called.
                   // it is possible to call die twice in some
                   // very peculiar circumstances.
                   // you have two objects that are bumping
@@ -295,9 +418,106 @@ void LifeForm::die(void)
                   // region resize is called for object 2
                   // region resize calls update position,
                   // which kills object 2 ('cause it's too weak)
-                  // space.remove(obj1) returns
+                  // world->space.remove(obj1) returns
                   // resolve_encounter calls obj2->die();
-    space.remove(pos);
-    is_alive = false;
+    if (world->trace) world->trace->died(*this);
+    world->space.remove(pos());
+
+    SpeciesStats& s = stats();
+    s.alive -= 1;
+    s.deaths += 1;
+    /* don't let rounding leave energy behind in an extinct species */
+    s.energy = s.alive ? s.energy - energy() : 0.0;
+
+    /* move to the graveyard, whoever was at the boundary takes our row */
+    uint32_t k = vector_pos;
+    vector_pos = all_life->bury(k);
+    (*all_life)[k]->vector_pos = k;
 }
 
+void LifeForm::come_alive(void)
+{
+    if (is_alive()) return;
+    if (world->trace) world->trace->born(*this);
+    uint32_t k = vector_pos;
+    vector_pos = all_life->revive(k);
+    (*all_life)[k]->vector_pos = k;
+
+    SpeciesStats& s = stats();
+    s.alive += 1;
+    s.births += 1;
+    s.energy += energy();
+}
+
+/*
+ * a TiledWorld moves a LifeForm to the tile that it has wandered into.
+ * its row, its place in the QuadTree and its share of the species totals
+ * (but not a birth or a death) go with it.  moving can only be done
+ * between windows, when no tile is running
+ */
+void LifeForm::move_to(World& dest)
+{
+    if (!is_alive() || world == &dest) return;
+    SmartPointer<LifeForm> self{ this };    // the tree holds a reference until we're out
+    {
+        World::Scope in(*world);
+        world->space.remove(pos());
+    }
+
+    SpeciesStats& s = stats();
+    s.alive -= 1;
+    s.energy = s.alive ? s.energy - energy() : 0.0;
+
+    /* copy our row to dest, then leave through the graveyard as the
+       destructor would */
+    uint32_t k = vector_pos;
+    uint32_t row = dest.all_life.push_back(this, *all_life, k);
+    vector_pos = all_life->bury(k);
+    (*all_life)[k]->vector_pos = k;
+    LifeForm* last = all_life->remove(vector_pos);
+    if (last) { last->vector_pos = vector_pos; }
+
+    world = &dest;
+    all_life = &dest.all_life;
+    vector_pos = all_life->revive(row);
+    (*all_life)[row]->vector_pos = row;
+
+    SpeciesStats& d = stats();
+    d.alive += 1;
+    d.energy += energy();
+
+    World::Scope in(dest);
+    dest.space.insert(self, pos(), [self](void) { self->region_resize(); });
+}
+
+/*
+ * a ShardedWorld moves a LifeForm to another process by remaking it
+ * there.  the one that is left behind departs: it leaves the QuadTree and
+ * the species totals as if it had died, but its death isn't counted, and
+ * the one that is remade arrives without counting a birth
+ */
+void LifeForm::depart(void)
+{
+    if (!is_alive()) return;
+    world->space.remove(pos());
+
+    SpeciesStats& s = stats();
+    s.alive -= 1;
+    s.energy = s.alive ? s.energy - energy() : 0.0;
+
+    uint32_t k = vector_pos;
+    vector_pos = all_life->bury(k);
+    (*all_life)[k]->vector_pos = k;
+}
+
+void LifeForm::arrive(void)
+{
+    if (is_alive()) return;
+    uint32_t k = vector_pos;
+    vector_pos = all_life->revive(k);
+    (*all_life)[k]->vector_pos = k;
+
+    SpeciesStats& s = stats();
+    s.alive += 1;
+    s.energy += energy();
+}
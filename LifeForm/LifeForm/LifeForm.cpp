@@ -5,12 +5,23 @@
 #include "tokens.h"
 #include "ObjInfo.h"
 #include "QuadTree.h"
+#include "NearbyCache.h"
 #include "Params.h"
 #include "LifeForm.h"
 #include "Event.h"
+#include "Probe.h"
+#include "Trace.h"
+#include "World.h"
 
 using namespace std;
 
+Initializer<LifeForm> __LifeForm_initializer;
+
+void LifeForm::initialize(void) {
+    Event::add_kind(&on_age, "LifeForm::age");
+    Event::add_kind(&on_digest, "LifeForm::gain_energy");
+    Event::add_kind(&on_border_cross, "LifeForm::border_cross");
+}
 
 template <typename T>
 void bound(T& x, const T& min, const T& max) {
@@ -21,128 +32,316 @@ void bound(T& x, const T& min, const T& max) {
 
 
 
-ObjInfo LifeForm::info_about_them(SmartPointer<LifeForm> neighbor) {
+ObjInfo LifeForm::info_about_them(const SmartPointer<LifeForm>& neighbor) {
     ObjInfo info;
     
-    info.species = neighbor->species_name();
-    info.health = neighbor->health();
-    info.distance = pos.distance(neighbor->position());
-    info.bearing = pos.bearing(neighbor->position());
-    info.their_speed = neighbor->speed;
-    info.their_course = neighbor->course;
+    info.species = neighbor->species();
+    /* a ghost is never alive, its health is that of the LifeForm it stands for */
+    info.health = neighbor->is_ghost() ? neighbor->energy() / start_energy : neighbor->health();
+    info.distance = pos().distance(neighbor->position());
+    info.bearing = pos().bearing(neighbor->position());
+    info.their_speed = neighbor->speed();
+    info.their_course = neighbor->course();
     return info;
 }
 
 void LifeForm::compute_next_move(void) { // a simple function that creates the next border_cross_event
-    if (!is_alive) return;
+    if (!is_alive()) return;
     if (border_cross_event != nullptr) border_cross_event -> cancel();
-    if (speed > 0) {
-        SmartPointer<LifeForm> p {this};
-        border_cross_event = new Event(space.distance_to_edge(pos, course)/speed + Point::tolerance,
-                                       [p](){ p -> border_cross();});
+    border_cross_event = nullptr;   // (a cancelled event is deleted when its time comes)
+    if (speed() > 0) {
+        border_cross_event = new Event(world->space.distance_to_edge(pos(), course())/speed() + Point::tolerance,
+                                       &on_border_cross, this);
     }
 }
 
 void LifeForm::update_position() {
-    double delta = Event::now() - update_time;
-    if (!is_alive) return;
+    double delta = Event::now() - update_time();
+    if (!is_alive()) return;
     if (delta < 0.001) return;
-    update_time = Event::now();
+    update_time() = Event::now();
     Point newPos;
-    newPos.xpos = pos.xpos + delta*speed*cos(course);
-    newPos.ypos = pos.ypos + delta*speed*sin(course);
-    energy -= movement_cost(speed, delta);
-    if (space.is_out_of_bounds(newPos)) {
+    newPos.xpos = pos().xpos + delta*speed()*all_life->dir_x[vector_pos];
+    newPos.ypos = pos().ypos + delta*speed()*all_life->dir_y[vector_pos];
+    add_energy(-all_life->move_cost[vector_pos] * delta);
+    if (world->space.is_out_of_bounds(newPos)) {
         die();
     }
-    else if(energy < min_energy) {
+    else if(energy() < min_energy) {
         die();
     }else{
-        space.update_position(pos, newPos);
-        pos = newPos;
+        world->space.update_position(pos(), newPos);
+        pos() = newPos;
+        if (world->owned && !world->owned->contains(newPos)) {
+            world->strays.push_back(SmartPointer<LifeForm>(this));
+        }
+    }
+}
+
+/*
+ * advance_all brings every moving LifeForm up to Event::now() at once,
+ * (e.g., so that a frame shows everybody where they are right now).
+ *
+ * The integration is done in one pass over the living rows of all_life,
+ * writing into scratch columns, with no calls and no branches so that
+ * the compiler can vectorize it.  The deaths and QuadTree moves found
+ * by that pass are applied afterwards: the deaths one at a time (die
+ * removes the object from the tree), and then all of the moves as a
+ * single batch so that the resize callbacks are invoked once the tree
+ * has reached its final shape.
+ */
+void LifeForm::advance_all(void) {
+    struct Step {
+        SmartPointer<LifeForm> who;     // keeps 'who' around while we work
+        Point new_pos;
+        double new_energy;
+    };
+    /* scratch space, kept between calls (one set per thread, each World
+       is advanced by its own thread) */
+    static thread_local vector<double> new_x, new_y, new_energy;
+    static thread_local vector<uint8_t> due, dies;
+    static thread_local vector<Step> dying, moving;
+    static thread_local vector<pair<Point, Point>> moves;
+
+    World* world = &World::current();
+    LifeFormState* all_life = &world->all_life;
+    const double now = Event::now();
+    const uint32_t n = all_life->num_alive();
+    const double xmin = world->space.upper_left().xpos;
+    const double ymax = world->space.upper_left().ypos;
+    const double xmax = world->space.lower_right().xpos;
+    const double ymin = world->space.lower_right().ypos;
+    new_x.resize(n);
+    new_y.resize(n);
+    new_energy.resize(n);
+    due.resize(n);
+    dies.resize(n);
+
+    const Point* p = all_life->pos.data();
+    const double* speed = all_life->speed.data();
+    const double* dir_x = all_life->dir_x.data();
+    const double* dir_y = all_life->dir_y.data();
+    const double* cost = all_life->move_cost.data();
+    const double* energy = all_life->energy.data();
+    const double* when = all_life->update_time.data();
+    for (uint32_t i = 0; i < n; i += 1) {
+        double delta = now - when[i];
+        double x = p[i].xpos + delta * speed[i] * dir_x[i];
+        double y = p[i].ypos + delta * speed[i] * dir_y[i];
+        double e = energy[i] - delta * cost[i];
+        new_x[i] = x;
+        new_y[i] = y;
+        new_energy[i] = e;
+        due[i] = (speed[i] > 0.0) & (delta >= 0.001);
+        /* the same bounds test as QuadTree::is_out_of_bounds */
+        dies[i] = (x < xmin) | (x >= xmax) | (y > ymax) | (y <= ymin)
+                | (e < min_energy);
+    }
+
+    dying.clear();
+    moving.clear();
+    for (uint32_t i = 0; i < n; i += 1) {
+        if (!due[i]) continue;
+        Step s{ (*all_life)[i], Point(new_x[i], new_y[i]), new_energy[i] };
+        if (dies[i]) dying.push_back(s);
+        else moving.push_back(s);
+    }
+
+    /* the resize callbacks from a death may already have brought some
+       of the others up to date (update_time == now), those are skipped */
+    for (Step& s : dying) {
+        if (!s.who->is_alive() || s.who->update_time() == now) continue;
+        s.who->update_time() = now;
+        s.who->set_energy(s.new_energy);
+        s.who->die();
+    }
+
+    moves.clear();
+    for (Step& s : moving) {
+        if (!s.who->is_alive() || s.who->update_time() == now) continue;
+        s.who->update_time() = now;
+        s.who->set_energy(s.new_energy);
+        moves.push_back(make_pair(s.who->pos(), s.new_pos));
+        s.who->pos() = s.new_pos;
+    }
+    world->space.update_positions(moves);
+
+    dying.clear();
+    moving.clear();
+}
+
+/* spread the bits of x out, so that bit k of x becomes bit 2k of the result */
+static uint32_t spread_bits(uint32_t x) {
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+/*
+ * reorder the living rows of all_life.  SPATIAL_ORDER sorts by the
+ * position of each object along a Z (Morton) curve through the grid,
+ * so that objects that are close in space are usually close in memory.
+ * SPECIES_ORDER groups each species together.  Both sorts are stable,
+ * so objects with equal keys keep their current order.
+ */
+void LifeForm::sort_living(LiveOrder order) {
+    if (order == ANY_ORDER) return;
+    static thread_local vector<uint32_t> key;
+    static thread_local vector<uint32_t> rows;
+    LifeFormState* all_life = &World::current().all_life;
+    const uint32_t n = all_life->num_alive();
+    key.resize(n);
+    rows.resize(n);
+    const double scale = 65535.0 / (double) grid_max;
+    for (uint32_t i = 0; i < n; i += 1) {
+        rows[i] = i;
+        if (order == SPATIAL_ORDER) {
+            const Point& p = all_life->pos[i];
+            key[i] = (spread_bits((uint32_t) (p.xpos * scale)) << 1)
+                | spread_bits((uint32_t) (p.ypos * scale));
+        }
+        else {
+            key[i] = (*all_life)[i]->species().index();
+        }
+    }
+    stable_sort(rows.begin(), rows.end(),
+        [](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+    all_life->permute_living(rows);
+    for (uint32_t i = 0; i < n; i += 1) {
+        (*all_life)[i]->vector_pos = i;
     }
 }
 
 void LifeForm::set_course(double course) {
-    if (!is_alive) return;
-    if (this->course == course)
+    Trace::Api api(*this, Trace::COURSE, course);
+    if (!is_alive()) return;
+    if (this->course() == course)
         return;
     if (border_cross_event != nullptr)
         border_cross_event -> cancel();
+    border_cross_event = nullptr;
     update_position();
-    this->course = course;
-    if(speed != 0)
+    this->course() = course;
+    all_life->dir_x[vector_pos] = cos(course);
+    all_life->dir_y[vector_pos] = sin(course);
+    if(speed() != 0)
         compute_next_move();
 }
 
 void LifeForm::set_speed(double speed) {
-    if (!is_alive) return;
-    if (this->speed == speed)
+    Trace::Api api(*this, Trace::SPEED, speed);
+    if (!is_alive()) return;
+    if (this->speed() == speed)
         return;
     if (border_cross_event != nullptr)
         border_cross_event -> cancel();
+    border_cross_event = nullptr;
     update_position();
-    this->speed = speed;
+    this->speed() = speed;
+    /* movement_cost is linear in time, so the cost of one time unit
+       is all we need to charge for any interval */
+    all_life->move_cost[vector_pos] = movement_cost(speed, 1.0);
     if(speed != 0)
         compute_next_move();
 }
 
-ObjList LifeForm::perceive(double distance) {
-    if (!is_alive) return vector<ObjInfo>{};
+/*
+ * clamp the perceive distance and charge for it.
+ * returns false if we are not (or are no longer) alive to look around
+ */
+bool LifeForm::pay_to_perceive(double& distance) {
+    Trace::Api api(*this, Trace::PERCEIVE, distance);
+    if (!is_alive()) return false;
     if (distance > max_perceive_range) distance = max_perceive_range;
     if (distance < min_perceive_range) distance = min_perceive_range;
-    vector<ObjInfo> res{};
-    energy -= perceive_cost(distance);
-    if (energy < min_energy) {
+    add_energy(-perceive_cost(distance));
+    if (energy() < min_energy) {
         die();
-        return res;
-    }
-    vector<SmartPointer<LifeForm>> ObjList = space.nearby(pos, distance);
-    for (auto i : ObjList) {
-        res.push_back(info_about_them(i));
+        return false;
     }
+    return true;
+}
+
+/*
+ * the perceive functions go straight from the QuadTree to ObjInfo,
+ * without building a list of SmartPointers in between (look_around and
+ * perceive_each are in World.h)
+ */
+ObjList LifeForm::perceive(double distance) {
+    ObjList res;
+    perceive_into(distance, res);
     return res;
 }
 
+void LifeForm::perceive_into(double distance, ObjList& res) {
+    PROBE("LifeForm::perceive");
+    res.clear();
+    if (!pay_to_perceive(distance)) return;
+    look_around(distance,
+        [this, &res](const SmartPointer<LifeForm>& other) { res.push_back(info_about_them(other)); });
+}
+
 void LifeForm::age() {
-    if (!is_alive) return;
-    energy -= age_penalty;
-    if (energy < min_energy) {
+    if (!is_alive()) return;
+    add_energy(-age_penalty);
+    if (energy() < min_energy) {
         die();
         return;
     }
-    SmartPointer<LifeForm> p(this);
-    new Event(age_frequency, [p]() { p->age(); });
+    new Event(age_frequency, &on_age, this);
 }
 
 void LifeForm::eat(SmartPointer<LifeForm> other) {
-    if (!is_alive || !other -> is_alive) return;
-    energy -= eat_cost_function();
-    if (energy < min_energy) {
+    if (!is_alive() || !other -> is_alive()) return;
+    add_energy(-eat_cost_function());
+    if (energy() < min_energy) {
         die();
         return;
     }
-    SmartPointer<LifeForm> p{this};
-    double gain = other -> energy * eat_efficiency;
-    new Event(digestion_time, [p, gain](){ p -> gain_energy(gain); });
+    double gain = other -> energy() * eat_efficiency;
+    new Event(digestion_time, &on_digest, this, gain);
+    if (world->trace) world->trace->ate(*this, *other);
     other->die();
+    stats().eats += 1;
 }
 
 void LifeForm::gain_energy(double gain) {
-    if(is_alive)
-        energy += gain;
+    if(is_alive())
+        add_energy(gain);
+}
+
+void LifeForm::add_energy(double delta) {
+    if (world->trace) world->trace->energy(*this, delta);
+    all_life->energy[vector_pos] += delta;
+    if (is_alive()) stats().energy += delta;
+}
+
+void LifeForm::set_energy(double e) {
+    if (is_alive()) stats().energy += e - energy();
+    all_life->energy[vector_pos] = e;
 }
 
 void LifeForm::check_encounter() {
-    if (!is_alive) return;
-    SmartPointer<LifeForm> other = space.closest(pos);
-    if (!other -> is_alive) return;
-    if (pos.distance(other -> pos) < encounter_distance) {
+    if (!is_alive()) return;
+    SmartPointer<LifeForm> other = world->space.closest(pos());
+    if (!other -> is_alive()) {
+        /* the LifeForm that a ghost stands for is in another tile, running
+           on another thread: the encounter waits for the next barrier */
+        if (other->is_ghost() && pos().distance(other -> pos()) < encounter_distance) {
+            world->border_encounters.push_back(std::make_pair(SmartPointer<LifeForm>{this}, other));
+        }
+        return;
+    }
+    if (pos().distance(other -> pos()) < encounter_distance) {
         this->resolve_encounter(other);
     }
 }
 
 void LifeForm::border_cross() {
+    border_cross_event = nullptr;   // this one, which is deleted when we return
     update_position();
     check_encounter();
     compute_next_move();
@@ -154,33 +353,36 @@ void LifeForm::region_resize() {
 }
 
 void LifeForm::resolve_encounter(SmartPointer<LifeForm> other) {
-    if (!is_alive || !other -> is_alive) return;
-    if ((energy -= encounter_penalty) < min_energy) {
+    PROBE("LifeForm::resolve_encounter");
+    if (!is_alive() || !other -> is_alive()) return;
+    add_energy(-encounter_penalty);
+    if (energy() < min_energy) {
         die();
     }
-    if ((other -> energy -= encounter_penalty) < min_energy) {
+    other -> add_energy(-encounter_penalty);
+    if (other -> energy() < min_energy) {
         die();
     }
-    if (!is_alive || !other -> is_alive) return;
+    if (!is_alive() || !other -> is_alive()) return;
     
-    Action a1 = encounter(info_about_them(other));
+    Action a1 = meet(other);
     SmartPointer<LifeForm> p {this};
-    Action a2 = other -> encounter(other -> info_about_them(p));
+    Action a2 = other -> meet(p);
     if (a1 == LIFEFORM_IGNORE && a2 == LIFEFORM_IGNORE) {
         return;
     } else if (a1 == LIFEFORM_EAT && a2 == LIFEFORM_IGNORE) {
-        if (drand48() < eat_success_chance(energy, other -> energy)) {
+        if (drand48() < eat_success_chance(energy(), other -> energy())) {
             eat(other);
         }
     } else if (a1 == LIFEFORM_IGNORE && a2 == LIFEFORM_EAT) {
-        if (drand48() < eat_success_chance(other -> energy, energy)) {
+        if (drand48() < eat_success_chance(other -> energy(), energy())) {
             other -> eat(p);
         }
     } else if (a1 == LIFEFORM_EAT && a2 == LIFEFORM_EAT) {
         double chanceMe = drand48();
         double chanceOther = drand48();
-        double successMe = eat_success_chance(energy, other -> energy);
-        double successOther = eat_success_chance(other -> energy, energy);
+        double successMe = eat_success_chance(energy(), other -> energy());
+        double successOther = eat_success_chance(other -> energy(), energy());
         if (chanceMe < successMe && chanceOther >= successOther)
             eat(other);
         else if (chanceOther < successOther && chanceMe >= successMe)
@@ -196,25 +398,25 @@ void LifeForm::resolve_encounter(SmartPointer<LifeForm> other) {
                         other -> eat(p);
                     break;
                 case BIG_GUY_WINS:
-                    if (energy >= other -> energy)
+                    if (energy() >= other -> energy())
                         eat(other);
                     else
                         other -> eat(p);
                     break;
                 case UNDERDOG_IS_HERE:
-                    if (energy <= other -> energy)
+                    if (energy() <= other -> energy())
                         eat(other);
                     else
                         other -> eat(p);
                     break;
                 case FASTER_GUY_WINS:
-                    if (speed >= other -> speed)
+                    if (speed() >= other -> speed())
                         eat(other);
                     else
                         other -> eat(p);
                     break;
                 case SLOWER_GUY_WINS:
-                    if (speed <= other -> speed)
+                    if (speed() <= other -> speed())
                         eat(other);
                     else
                         other -> eat(p);
@@ -226,49 +428,84 @@ void LifeForm::resolve_encounter(SmartPointer<LifeForm> other) {
     
 }
 
+Action LifeForm::meet(const SmartPointer<LifeForm>& other) {
+    if (world->trace) return world->trace->encounter(*this, *other, info_about_them(other));
+    return encounter(info_about_them(other));
+}
+
 void LifeForm::reproduce(SmartPointer<LifeForm> child){
+    PROBE("LifeForm::reproduce");
+    Trace::Api api(*this, Trace::REPRODUCE, 0.0, &*child);
+    /* the child's stream comes from ours, not from the order in which
+       its World happened to make LifeForms */
+    child->random = RandomStream(random.next_bits());
     double timeInterval = Event::now() - reproduce_time;
-    if((!is_alive) || (timeInterval < min_reproduce_time)){
+    if((!is_alive()) || (timeInterval < min_reproduce_time)){
         if(child->border_cross_event != nullptr)
             child->border_cross_event->cancel();
+        child->border_cross_event = nullptr;
         child->die();
     }else{
-        double newEnergy = (this->energy * (1.0 - reproduce_cost)) / 2;
+        double newEnergy = (this->energy() * (1.0 - reproduce_cost)) / 2;
         if(newEnergy < min_energy){
             if(child->border_cross_event != nullptr)
                 child->border_cross_event->cancel();
+            child->border_cross_event = nullptr;
             child->die();
             if(this->border_cross_event != nullptr)
                 this->border_cross_event->cancel();
+            this->border_cross_event = nullptr;
             this->die();
             return;
         }
-        this->energy = newEnergy;
-        child->energy = newEnergy;
+        this->set_energy(newEnergy);
+        child->set_energy(newEnergy);
+        /* a free place within reproduce_dist, if there is one */
+        Point place;
+        bool placeFinded = world->space.free_point(pos(), reproduce_dist, encounter_distance,
+                                                   [this](void) { return drand48(); }, place);
         SmartPointer<LifeForm> nearest;
-        bool placeFinded = false;
-        int i = 0;
-        while((i < 20) && (placeFinded == false)){
-            child->pos.ypos = this->pos.ypos + sin(drand48() * 2.0 * M_PI) * drand48() * reproduce_dist;
-            child->pos.xpos = this->pos.ypos + cos(drand48() * 2.0 * M_PI) * drand48() * reproduce_dist;
-            nearest = space.closest(child->pos);
-            if(nearest && nearest->position().distance(child->position()) > encounter_distance
-               && !space.is_out_of_bounds(child -> position()))
-                placeFinded = true;
-            i++;
+        if(placeFinded == false){
+            /* there is no room: the child goes anywhere within
+               reproduce_dist (pulled back towards us until it is in
+               bounds), and runs into its nearest neighbour */
+            double angle = drand48() * 2.0 * M_PI;
+            double dist = drand48() * reproduce_dist;
+            place = Point(pos().xpos + cos(angle) * dist, pos().ypos + sin(angle) * dist);
+            for (int k = 0; k < 64 && world->space.is_out_of_bounds(place); k++) {
+                place = Point((place.xpos + pos().xpos) / 2.0, (place.ypos + pos().ypos) / 2.0);
+            }
+            if (world->space.is_out_of_bounds(place) || world->space.is_occupied(place)) {
+                /* (it landed right on top of someone): the child is lost */
+                if(child->border_cross_event != nullptr)
+                    child->border_cross_event->cancel();
+                child->border_cross_event = nullptr;
+                child->die();
+                return;
+            }
+            nearest = world->space.closest(place);
         }
-        child->start_point = child->pos;
-        child->is_alive = true;
+        child->pos() = place;
+        child->start_point = child->pos();
+        child->come_alive();
+#if DEBUG
         cout << "I'm here!!" << endl;
-        space.insert(child, child->pos, [child](void) { child->region_resize(); });
+#endif /* DEBUG */
+        world->space.insert(child, child->pos(), [child](void) { child->region_resize(); });
+#if DEBUG
         cout << "Finish insertion" << endl;
-        new Event(age_frequency, [child](void) { child->age(); });
-        if(child->speed != 0 && child->is_alive)
+#endif /* DEBUG */
+        new Event(age_frequency, &on_age, &*child);
+        if(child->speed() != 0 && child->is_alive())
             child->compute_next_move();
+#if DEBUG
         cout << "Add border_cross event!" << endl;
+#endif /* DEBUG */
         this->reproduce_time = Event::now();
         if(placeFinded == false){
+#if DEBUG
             cout << "Can't find safety place" << endl;
+#endif /* DEBUG */
             child->resolve_encounter(nearest);
         }
         
@@ -15,7 +15,11 @@
 
 #include "Params.h"
 #include "Point.h"
+#include "Random.h"
 #include "SmartPointer.h"
+#include "Init.h"
+#include "LifeFormState.h"
+#include "Species.h"
 
 
 /* forward declarations */
@@ -24,6 +28,9 @@ class istream;
 struct ObjInfo;
 typedef std::vector<ObjInfo> ObjList;
 template <typename Obj> class QuadTree;
+template <typename Obj> class NearbyCache;
+class World;
+class Packet;
 
 /* 
  * The map will contain IstreamCreators for LifeForms
@@ -54,34 +61,64 @@ enum Action {
 
 class LifeForm : public ControlBlock {
 private:
-	/* space is the global storage that represents the 2-dimensional simulation area */
-    static QuadTree<SmartPointer<LifeForm>> space;
-
+    /* world is the World that this LifeForm is in: the current World at
+     * the time it was created (see World.h), or the tile it has since
+     * moved to (see move_to and TiledWorld.h).  What used to be global to
+     * the simulation is in world:
+     *   world->space is the storage that represents the 2-dimensional simulation area
+     *   world->perceive_cache holds the answers to the perceive queries made
+     *     at the current instant, used only when compiled with
+     *     PERCEIVE_CACHE (see NearbyCache.h)
+     *   world->perceive_sweep holds the answers to the perceive queries of
+     *     the events (of kinds that perceive) due at the current instant,
+     *     found together,
+     *     used only when compiled with PERCEIVE_SWEEP (see PerceiveSweep.h)
+     *   world->win is the Canvas that we are drawn on
+     * static member functions don't have a world of their own, they use
+     * World::current()
+     */
+    World* world;
 
     /* In order to perform the graphics output and to keep track of
      * which species have become extinct, we need a mechanism to scan
-     * all of the LifeForms that are alive. I'm creating a std::vector<LifeForm*>
-     * to hold pointers to every LifeForm. Objects insert themselves (*this)
-     * into the vector in the LifeForm constructor, and remove themselves
-     * from the vector in their destructor. The name of the vector is all_life
+     * all of the LifeForms that are alive. all_life (&world->all_life, but
+     * it's used so often that we keep a pointer to it) holds a row for
+     * every LifeForm. Objects insert themselves (*this)
+     * into all_life in the LifeForm constructor, and remove themselves
+     * from all_life in their destructor.
      *
-     * There are two caveats
+     * There are three caveats
      *
      * 1. some lifeforms may be dead, yet their destructors may not yet
      * have been run (e.g., student species can create lots of LifeForm objects
-     * by just calling "new Craig[1000]"). So, we have an is_alive flag that
-     * will be false in LifeForms that are outside of the simulation. The all_life
-     * vector will include pointers to all LifeForms (alive or dead).
-     * 2. removing LifeForm objects from the vector is facilitated by having each LifeForm
-     * remember its position in the vector. When we remove LifeForm (e.g,. LifeForm #10)
-     * we simply replace that position with a pointer to the last LifeForm in the vector
-     * and then pop_back the LifeForm at the end. The vector_pos data member tells each
-     * LifeForm object where it can find this in the all_life vector
+     * by just calling "new Craig[1000]"). all_life will include rows for
+     * all LifeForms (alive or dead), but the living rows are kept together
+     * at the front (all_life.living()) and the rest are the graveyard
+     * (all_life.graveyard()). A LifeForm is alive iff its row is at the front.
+     * 2. removing LifeForm objects from all_life is facilitated by having each LifeForm
+     * remember its row. When we remove LifeForm (e.g,. LifeForm #10)
+     * we simply replace that row with the last row
+     * and then pop_back the row at the end. The vector_pos data member tells each
+     * LifeForm object where it can find its row in all_life.  come_alive and
+     * die move rows between the two parts the same way (see LifeFormState.h)
+     * 3. the hot state of a LifeForm (pos, speed, course, update_time and
+     * energy) lives in the columns of all_life, not in the object
+     * (see LifeFormState.h). The accessors below redirect into the columns,
+     * so any reference they return is only good until the next LifeForm is
+     * constructed, destroyed, comes alive or dies.
      *
      */
-      static std::vector<LifeForm*> all_life;
+      LifeFormState* all_life;
       uint32_t vector_pos;
 
+      /* world->species_stats[s.index()] holds the totals for Species s, so that
+       * reporting and the termination checks never have to scan all_life.
+       * To keep the totals right, energy is only changed with add_energy
+       * and set_energy, a LifeForm enters the simulation with come_alive,
+       * and it leaves with die.
+       */
+      SpeciesStats& stats(void);    // our row of world->species_stats
+
       /* istream_creators is a map, indexed by strings, and returning functions
        * the functions create the correct subtype of LifeForm
        * i.e., istream_creators["Craig"] returns a function. If you call that
@@ -101,26 +138,36 @@ private:
       void print_position(void) const; // print and print_position are provided for debugging purposes
       void print(void) const;
 
-      double energy;
-      bool is_alive;
+      double energy(void) const { return all_life->energy[vector_pos]; }
+      void add_energy(double);      // energy += delta (the delta may be negative)
+      void set_energy(double);
+      bool is_alive(void) const { return all_life->is_alive(vector_pos); }
 
       Event* border_cross_event;    // pointer to the event for the next encounter with a boundary
       void border_cross(void);		// the event handler function for the border cross event
 
       void region_resize(void);		// the callback function for region resizes (invoked by the quadtree)
 
-      Point pos;
-      double update_time;           // the time when update_position was 
+      Point& pos(void) { return all_life->pos[vector_pos]; }
+      double& update_time(void) { return all_life->update_time[vector_pos]; }
+                                // the time when update_position was
                                 //   last called
+      double& course(void) { return all_life->course[vector_pos]; }
+      double course(void) const { return all_life->course[vector_pos]; }
+      double& speed(void) { return all_life->speed[vector_pos]; }
+      double speed(void) const { return all_life->speed[vector_pos]; }
+
       double reproduce_time;        // the time when reproduce was last called
-      double course;
-      double speed;
+      RandomStream random;          // ours, see drand48
+      uint64_t handle;              // the number of our stream, our name in a Trace
+      mutable Species my_species;   // species_name(), interned on first use by species()
 
       Point start_point;			// start_point is sometimes used by the test program(s)
 								// you can (and should) ignore it
 
 
       void resolve_encounter(SmartPointer<LifeForm>);
+      Action meet(const SmartPointer<LifeForm>&);  // encounter(), recorded if there is a Trace
       void eat(SmartPointer<LifeForm>);
       void age(void);               // subtract age_penalty from energy
       void gain_energy(double);
@@ -137,53 +184,118 @@ private:
                                 // on ourself with the closest object
   
       void die(void);          // kill the current life form
+      void come_alive(void);   // the opposite of die, for a LifeForm that has
+                               // just been placed in space
+      void move_to(World&);    // leave our World for another (alive, with our events
+                               // left for the caller to move, see Event::move_owned)
+      void depart(void);       // die, when we have moved to another process (not a death)
+      void arrive(void);       // come_alive, when we have just been remade here by the
+                               // process we came from (not a birth, see ShardedWorld.h)
+
+      /* a ghost is the stand-in, in one tile of a TiledWorld, for a
+         LifeForm of a neighboring tile (see TiledWorld.cpp).  ghosts are
+         never alive, but they can be perceived and encountered */
+      virtual bool is_ghost(void) const { return false; }
 
 
       void compute_next_move(void); // a simple function that creates the next border_cross_event
 
-      ObjInfo info_about_them(SmartPointer<LifeForm>);
+      /* the Event kinds for the handlers above (see Event.h), registered
+         by initialize, so that the events can be saved in a checkpoint */
+      static void initialize(void);
+      static void on_age(LifeForm* p, double) { p->age(); }
+      static void on_digest(LifeForm* p, double gain) { p->gain_energy(gain); }
+      static void on_border_cross(LifeForm* p, double) { p->border_cross(); }
 
-      const Point& position() const { return pos; }
+      ObjInfo info_about_them(const SmartPointer<LifeForm>&);
+      bool pay_to_perceive(double&);    // the common start of the perceive functions
+      template <typename Visitor>
+      void look_around(double, Visitor); // the common end of the perceive functions
+
+      const Point& position() const { return all_life->pos[vector_pos]; }
 
-      static Canvas win;
 protected:
+      double drand48(void) { return random.next(); }
+                                    // uniform in [0, 1), from our own RandomStream
+                                    // (this hides the C library's drand48).  A
+                                    // LifeForm's stream is handed out by its World
+                                    // when it is made, and reproduce gives the child
+                                    // one drawn from the parent's, so what a LifeForm
+                                    // draws never depends on the order in which
+                                    // LifeForms (or the threads running them) draw
       double health(void) const {
-    	  if (!is_alive) { return 0.0; }
-    	  else { return energy / start_energy; }
+    	  if (!is_alive()) { return 0.0; }
+    	  else { return energy() / start_energy; }
       }
       void set_course(double);
       void set_speed(double);
-      double get_course(void) const { return course; }
-      double get_speed(void) const { return speed; }
+      double get_course(void) const { return course(); }
+      double get_speed(void) const { return speed(); }
       void reproduce(SmartPointer<LifeForm>);
       ObjList perceive(double);
+      void perceive_into(double, ObjList&);  // perceive into the caller's list (which is reused)
+      template <typename Visitor>
+      void perceive_each(double, Visitor);
+                                    // perceive, handing each ObjInfo to visit(info)
+                                    // as it is found (no list is built at all).
+                                    // visit must not change the simulation
+                                    // (no set_course, set_speed, reproduce, ...).
+                                    // It is defined in World.h, since it needs the World
+
+      /* the Event* members of this LifeForm (a species adds its own), so
+         that a TimeWarp can put them back as they were when it rolls back */
+      virtual void event_members(std::vector<Event**>& out) { out.push_back(&border_cross_event); }
+
+      /* a species with state of its own (other than its Event* members)
+         saves it in a checkpoint, and gets it back when the checkpoint is
+         restored, in the same order (see Checkpoint.h) */
+      virtual void save_state(Packet&) const {}
+      virtual void restore_state(Packet&) {}
 
 public:
       LifeForm(void);
       virtual ~LifeForm(void);
 
+      World& home(void) const { return *world; }    // the World we are in
+
       static void add_creator(IstreamCreator, const std::string&);
       static void create_life();
+      static void populate(void);   // the part of create_life that reads config.test
       /* draw the lifeform on 'win' where x,y is upper left corner */
       virtual void draw(int, int) const;
       virtual Color my_color(void) const = 0;
 
       void display(void) const;
+      static void advance_all(void);    // update_position for every LifeForm, in one pass
+      static void sort_living(LiveOrder); // put the living rows of all_life in this order
       static void redisplay_all(void);
+      static void report(World&, uint32_t num_objects, unsigned num_events);
+                                    // the species summary of a World, and the
+                                    // termination checks (which stop the World)
       static void clear_screen(void);
 
       virtual Action encounter(const ObjInfo&) = 0;
       virtual std::string species_name(void) const = 0;
       virtual std::string player_name(void) const;
+      Species species(void) const;  // species_name(), interned (cheap to call and compare)
 
 friend class Algae;
+friend class Event;
+friend class TiledWorld;
+friend class TimeWarp;
+friend class ShardedWorld;
+friend class Checkpoint;
+friend class Trace;
+friend class Replay;
+friend class Puppet;
+friend class Initializer<LifeForm>;
 
 /*
  * the following functions are used by the test program(s) and should not be used by students (except, of course,
  * during testing, feel free to write your own test programs)
  */
     bool confirmPosition(double xpos, double ypos) {
-    	return pos.distance(Point(xpos,ypos)) < 0.10;
+    	return position().distance(Point(xpos,ypos)) < 0.10;
     }
 
     static void runTests(void);
@@ -0,0 +1,208 @@
+#if !(_LifeFormState_h)
+#define _LifeFormState_h 1
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Point.h"
+
+class LifeForm;
+
+/*
+ * LifeFormState is the storage behind World::all_life.
+ *
+ * The fields that the simulator touches for every object on every pass
+ * (position, motion and energy) are not stored inside the LifeForm objects.
+ * Instead, each of them is a column (a std::vector) and row k of every
+ * column belongs to the LifeForm life[k].  Each LifeForm remembers its row
+ * in vector_pos, exactly as it used to remember its position in the old
+ * std::vector<LifeForm*>.
+ *
+ * The rows are kept in two parts:
+ *   rows [0, num_alive()) are the living, with no gaps (see living())
+ *   rows [num_alive(), size()) are the graveyard: LifeForms that have died,
+ *      or have not yet been placed in the simulation, but are still
+ *      referenced (e.g., by pending events) so they have not been
+ *      destroyed (see graveyard())
+ * A LifeForm is alive exactly when its row is in the first part, so there
+ * is no is_alive column.  Whole-population passes (redisplay_all,
+ * advance_all) walk the living part of the columns linearly, and never
+ * see a dead object.
+ *
+ * Moving between the two parts is a swap with the row at the boundary
+ * (revive and bury), and destroyed LifeForms are removed from the graveyard
+ * the same way entries were removed from the old vector: the last row is
+ * moved into the hole and then every column is popped.  All three return
+ * enough for the caller to fix up the vector_pos of the LifeForm that was
+ * moved out of the way.
+ */
+class LifeFormState {
+public:
+    std::vector<LifeForm*> life;        // the owner of each row
+    std::vector<Point> pos;
+    std::vector<double> speed;
+    std::vector<double> course;
+    std::vector<double> update_time;    // the time when update_position was last called
+    std::vector<double> energy;
+
+    /* derived columns, kept up to date by set_course and set_speed so that
+       moving an object never has to call cos, sin or pow */
+    std::vector<double> dir_x;          // cos(course)
+    std::vector<double> dir_y;          // sin(course)
+    std::vector<double> move_cost;      // movement_cost(speed, 1.0), the energy spent per time unit
+
+    using const_iterator = std::vector<LifeForm*>::const_iterator;
+
+    /* a pair of iterators that can be used in a range-based for */
+    struct Range {
+        const_iterator first, last;
+        const_iterator begin(void) const { return first; }
+        const_iterator end(void) const { return last; }
+        uint32_t size(void) const { return (uint32_t) (last - first); }
+    };
+
+    uint32_t size(void) const { return (uint32_t) life.size(); }
+    uint32_t num_alive(void) const { return alive; }
+    bool is_alive(uint32_t k) const { return k < alive; }
+    LifeForm* operator[](uint32_t k) const { return life[k]; }
+    const_iterator begin(void) const { return life.begin(); }
+    const_iterator end(void) const { return life.end(); }
+    Range living(void) const { return Range{ life.begin(), life.begin() + alive }; }
+    Range graveyard(void) const { return Range{ life.begin() + alive, life.end() }; }
+
+    /* append a row for 'lf' (in the graveyard) and return its index */
+    uint32_t push_back(LifeForm* lf) {
+        life.push_back(lf);
+        pos.push_back(Point(0, 0));
+        speed.push_back(0.0);
+        course.push_back(0.0);
+        update_time.push_back(0.0);
+        energy.push_back(0.0);
+        dir_x.push_back(1.0);
+        dir_y.push_back(0.0);
+        move_cost.push_back(0.0);
+        return size() - 1;
+    }
+
+    /* append a row for 'lf' (in the graveyard) that is a copy of row k of
+       'from', and return its index (when lf moves to another World) */
+    uint32_t push_back(LifeForm* lf, const LifeFormState& from, uint32_t k) {
+        life.push_back(lf);
+        pos.push_back(from.pos[k]);
+        speed.push_back(from.speed[k]);
+        course.push_back(from.course[k]);
+        update_time.push_back(from.update_time[k]);
+        energy.push_back(from.energy[k]);
+        dir_x.push_back(from.dir_x[k]);
+        dir_y.push_back(from.dir_y[k]);
+        move_cost.push_back(from.move_cost[k]);
+        return size() - 1;
+    }
+
+    /*
+     * move row k (in the graveyard) to the end of the living rows.
+     * returns the new index of the row, row k now belongs to life[k]
+     */
+    uint32_t revive(uint32_t k) {
+        assert(k >= alive && k < size());
+        swap_rows(k, alive);
+        return alive++;
+    }
+
+    /*
+     * move row k (a living row) to the start of the graveyard.
+     * returns the new index of the row, row k now belongs to life[k]
+     */
+    uint32_t bury(uint32_t k) {
+        assert(k < alive);
+        alive -= 1;
+        swap_rows(k, alive);
+        return alive;
+    }
+
+    /* move every living row to the graveyard (when a World is destroyed) */
+    void bury_all(void) { alive = 0; }
+
+    /*
+     * remove row k (in the graveyard) by moving the last row into its place.
+     * returns the LifeForm that now owns row k (so the caller can fix its
+     * vector_pos), or nullptr if k was the last row
+     */
+    LifeForm* remove(uint32_t k) {
+        assert(k >= alive && k < size());
+        uint32_t last = size() - 1;
+        LifeForm* moved = nullptr;
+        if (k != last) {
+            move_row(last, k);
+            moved = life[k];
+        }
+        life.pop_back();
+        pos.pop_back();
+        speed.pop_back();
+        course.pop_back();
+        update_time.pop_back();
+        energy.pop_back();
+        dir_x.pop_back();
+        dir_y.pop_back();
+        move_cost.pop_back();
+        return moved;
+    }
+
+    /*
+     * rearrange the living rows so that row k holds what was in row
+     * order[k] (order must be a permutation of [0, num_alive())).
+     * the caller must fix the vector_pos of every living LifeForm
+     */
+    void permute_living(const std::vector<uint32_t>& order) {
+        assert(order.size() == alive);
+        permute(life, order);
+        permute(pos, order);
+        permute(speed, order);
+        permute(course, order);
+        permute(update_time, order);
+        permute(energy, order);
+        permute(dir_x, order);
+        permute(dir_y, order);
+        permute(move_cost, order);
+    }
+
+private:
+    uint32_t alive = 0;                 // the number of living rows
+
+    void move_row(uint32_t from, uint32_t to) {
+        life[to] = life[from];
+        pos[to] = pos[from];
+        speed[to] = speed[from];
+        course[to] = course[from];
+        update_time[to] = update_time[from];
+        energy[to] = energy[from];
+        dir_x[to] = dir_x[from];
+        dir_y[to] = dir_y[from];
+        move_cost[to] = move_cost[from];
+    }
+
+    void swap_rows(uint32_t a, uint32_t b) {
+        if (a == b) return;
+        std::swap(life[a], life[b]);
+        std::swap(pos[a], pos[b]);
+        std::swap(speed[a], speed[b]);
+        std::swap(course[a], course[b]);
+        std::swap(update_time[a], update_time[b]);
+        std::swap(energy[a], energy[b]);
+        std::swap(dir_x[a], dir_x[b]);
+        std::swap(dir_y[a], dir_y[b]);
+        std::swap(move_cost[a], move_cost[b]);
+    }
+
+    template <typename T>
+    static void permute(std::vector<T>& column, const std::vector<uint32_t>& order) {
+        std::vector<T> old(column.begin(), column.begin() + order.size());
+        for (uint32_t k = 0; k < order.size(); k += 1) {
+            column[k] = old[order[k]];
+        }
+    }
+};
+
+#endif /* !(_LifeFormState_h) */
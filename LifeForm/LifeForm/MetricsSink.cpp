@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+
+#include "MetricsSink.h"
+
+using namespace std;
+
+MetricsSink::MetricsSink(const string& target) {
+    csv = target.size() >= 4 && target.compare(target.size() - 4, 4, ".csv") == 0;
+    out = fopen(target.c_str(), "w");
+    if (out == nullptr) {
+        cerr << "MetricsSink: cannot open " << target << "\n";
+        return;
+    }
+    buffer.reserve(buffer_size + 4096);
+    full.reserve(buffer_size + 4096);
+    if (csv) {
+        append("time,live,events,species,alive,energy,births,deaths,eats\n");
+    }
+    worker = thread([this](void) { run(); });
+}
+
+/* printf onto the end of buffer */
+void MetricsSink::append(const char* format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n > 0) buffer.append(line, std::min((size_t) n, sizeof(line) - 1));
+}
+
+void MetricsSink::begin_record(double t, unsigned long l, unsigned long e) {
+    if (!ok()) return;
+    time = t;
+    live = l;
+    events = e;
+    first_species = true;
+    if (!csv) {
+        append("{\"time\":%.10g,\"live\":%lu,\"events\":%lu,\"species\":[", time, live, events);
+    }
+}
+
+void MetricsSink::add_species(const string& name, const SpeciesStats& s) {
+    if (!ok()) return;
+    if (csv) {
+        append("%.10g,%lu,%lu,%s,%u,%.10g,%lu,%lu,%lu\n", time, live, events,
+            name.c_str(), s.alive, s.energy, s.births, s.deaths, s.eats);
+    }
+    else {
+        /* species names are identifiers, they never need escaping */
+        append("%s{\"name\":\"%s\",\"alive\":%u,\"energy\":%.10g,\"births\":%lu,\"deaths\":%lu,\"eats\":%lu}",
+            first_species ? "" : ",", name.c_str(), s.alive, s.energy, s.births, s.deaths, s.eats);
+    }
+    first_species = false;
+}
+
+void MetricsSink::end_record(void) {
+    if (!ok()) return;
+    if (!csv) append("]}\n");
+    if (buffer.size() >= buffer_size) hand_off();
+}
+
+void MetricsSink::hand_off(void) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this](void) { return !has_full; });
+    full.swap(buffer);
+    has_full = true;
+    changed.notify_all();
+}
+
+void MetricsSink::close(void) {
+    if (!worker.joinable()) return;
+    if (!buffer.empty()) hand_off();
+    {
+        lock_guard<mutex> guard(lock);
+        closing = true;
+        changed.notify_all();
+    }
+    worker.join();
+    fclose(out);
+    out = nullptr;
+}
+
+/* write each full buffer as it arrives, until close is called */
+void MetricsSink::run(void) {
+    unique_lock<mutex> guard(lock);
+    for (;;) {
+        changed.wait(guard, [this](void) { return closing || has_full; });
+        if (!has_full) return;          // closing, and everything is written
+        guard.unlock();
+        fwrite(full.data(), 1, full.size(), out);
+        fflush(out);
+        guard.lock();
+        full.clear();
+        has_full = false;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,68 @@
+#if !(_MetricsSink_h)
+#define _MetricsSink_h 1
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Species.h"
+
+/*
+ * Class name: MetricsSink
+ * Description:
+ *  Writes the species summary as data instead of text, one record per
+ *  report, to a file that is easy to load into other tools.  The format
+ *  is chosen by the name of the file:
+ *
+ *      "run.csv"       CSV with a header line, one row per species per
+ *                      report:  time,live,events,species,alive,energy,births,deaths,eats
+ *      anything else   JSON Lines, one object per report:
+ *                      {"time":..,"live":..,"events":..,"species":[{"name":..,"alive":..,...},...]}
+ *
+ *  A report is written with
+ *      begin_record(time, live, events);
+ *      add_species(name, stats);     // for each species
+ *      end_record();
+ *
+ *  The records are formatted into a large buffer in memory.  When the
+ *  buffer is full it is handed to a background thread to be written, and
+ *  formatting continues in a second buffer, so the simulation only waits
+ *  for the disk if the disk is slower than two full buffers.
+ *  close() (or the destructor) writes whatever is left.
+ */
+class MetricsSink {
+public:
+    MetricsSink(const std::string& target);
+    ~MetricsSink(void) { close(); }
+
+    bool ok(void) const { return out != nullptr; }
+    void begin_record(double time, unsigned long live, unsigned long events);
+    void add_species(const std::string& name, const SpeciesStats&);
+    void end_record(void);
+    void close(void);
+
+private:
+    static const size_t buffer_size = 1 << 20;
+
+    void append(const char* format, ...);
+    void hand_off(void);                // give the full buffer to the writer
+    void run(void);                     // the background thread
+
+    FILE* out = nullptr;
+    bool csv;
+    std::string buffer;                 // being formatted
+    double time;                        // of the current record
+    unsigned long live, events;
+    bool first_species;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::string full;                   // being written by the background thread
+    bool has_full = false;
+    bool closing = false;
+    std::thread worker;
+};
+
+#endif /* !(_MetricsSink_h) */
@@ -0,0 +1,175 @@
+#if !(_NearbyCache_h)
+#define _NearbyCache_h 1
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Point.h"
+#include "QuadTree.h"
+#include "SimTime.h"
+
+/*
+ * Class name: NearbyCache
+ * Description:
+ *  Remembers the answers to QuadTree::visit_nearby queries made at one
+ *  simulated instant, so that objects that look around the same area at
+ *  the same time (e.g., a crowd of hunters that all wake up together)
+ *  share one walk of the tree.
+ *
+ *  Queries are keyed by (the grid cell of the center, the radius, the time).
+ *  A cell holds the answer for a circle around the middle of the cell
+ *  that is large enough to contain the answer for any center inside the
+ *  cell.  A hit filters that answer down to the exact circle, so a hit
+ *  returns exactly what the tree would have returned, in the same order.
+ *
+ *  All answers are dropped when the time changes.  When the tree changes
+ *  (QuadTree::version), only the answers whose circle covers a point
+ *  where an object was inserted, removed or moved are dropped (see
+ *  QuadTree::changes_since), so that a hunter stepping forward before
+ *  it looks does not throw away what its neighbors have found.
+ *  If the tree has changed too much to say where, everything is dropped.
+ *  Either way, a cache never needs to be told about changes to the tree.
+ *
+ *  hits() and misses() count the queries, so that the benefit of the
+ *  cache can be judged for each scenario.
+ */
+template <class Obj>
+class NearbyCache {
+public:
+    /* the default cell is about as wide as a hunter looks */
+    NearbyCache(double cell_size = 20.0) : cell(cell_size) {}
+
+    template <typename Visitor>
+    void visit_nearby(const QuadTree<Obj>& tree, const Point& center,
+                      double radius, SimTime now, Visitor visit);
+
+    /* forget every answer, e.g. when the World has been rolled back to
+       an earlier state of the tree at the same time (see TimeWarp.h) */
+    void clear(void) { entries.clear(); radii.clear(); time = -1.0; }
+
+    unsigned long hits(void) const { return num_hits; }
+    unsigned long misses(void) const { return num_misses; }
+    double hit_rate(void) const {
+        unsigned long total = num_hits + num_misses;
+        return total ? (double) num_hits / (double) total : 0.0;
+    }
+
+private:
+    struct Key {
+        long qx, qy;
+        double radius;
+        bool operator==(const Key& k) const {
+            return qx == k.qx && qy == k.qy && radius == k.radius;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            size_t h = std::hash<long>()(k.qx);
+            h = h * 31 + std::hash<long>()(k.qy);
+            return h * 31 + std::hash<double>()(k.radius);
+        }
+    };
+    struct Entry {
+        bool valid = false;
+        Point middle;           // the circle that was searched
+        double reach = 0.0;
+        std::vector<std::pair<Obj, Point>> found;
+    };
+    typedef std::unordered_map<Key, Entry, KeyHash> Table;
+
+    void forget_near(const Point&);
+    void forget_all_near(const Point&);     // the same, by walking the whole table
+
+    double cell;
+    SimTime time = -1.0;
+    unsigned long version = 0;
+    Table entries;
+    std::vector<double> radii;  // the radii of the keys in entries (a few, at most)
+    unsigned long num_hits = 0;
+    unsigned long num_misses = 0;
+};
+
+template <class Obj>
+template <typename Visitor>
+void NearbyCache<Obj>::visit_nearby(const QuadTree<Obj>& tree, const Point& center,
+                                    double radius, SimTime now, Visitor visit) {
+    if (now != time) {
+        time = now;
+        entries.clear();
+        radii.clear();
+    }
+    else if (tree.version() != version) {
+        bool known = tree.changes_since(version,
+            [this](const Point& p) { forget_near(p); });
+        if (!known) entries.clear();
+    }
+    version = tree.version();
+
+    Key key{ (long) std::floor(center.xpos / cell), (long) std::floor(center.ypos / cell), radius };
+    Entry& e = entries[key];
+    if (e.valid) {
+        num_hits += 1;
+    }
+    else {
+        num_misses += 1;
+        if (std::find(radii.begin(), radii.end(), radius) == radii.end()) radii.push_back(radius);
+        e.valid = true;
+        e.found.clear();
+        /* any center inside the cell is within half a diagonal of its middle */
+        e.middle = Point((key.qx + 0.5) * cell, (key.qy + 0.5) * cell);
+        e.reach = radius + cell * 0.7072;
+        tree.visit_within(e.middle, e.reach, [&e](const Obj& obj, const Point& pos) {
+            e.found.push_back(std::make_pair(obj, pos));
+        });
+    }
+
+    /* the same test as QuadTree::visit_nearby, applied to the cell's answer */
+    for (const auto& f : e.found) {
+        if (f.second != center && center.distance(f.second) <= radius)
+            visit(f.first);
+    }
+}
+
+/*
+ * drop every answer that a change to the tree at 'p' could affect: for
+ * each radius, only the cells whose circles can reach p are looked up
+ * (or the whole table is walked, if that is shorter)
+ */
+template <class Obj>
+void NearbyCache<Obj>::forget_near(const Point& p) {
+    for (double radius : radii) {
+        double reach = radius + cell * 0.7072;
+        long x0 = (long) std::floor((p.xpos - reach) / cell);
+        long x1 = (long) std::floor((p.xpos + reach) / cell);
+        long y0 = (long) std::floor((p.ypos - reach) / cell);
+        long y1 = (long) std::floor((p.ypos + reach) / cell);
+        if ((double) (x1 - x0 + 1) * (double) (y1 - y0 + 1) * radii.size() > entries.size()) {
+            forget_all_near(p);
+            return;
+        }
+        for (long qx = x0; qx <= x1; qx++) {
+            for (long qy = y0; qy <= y1; qy++) {
+                typename Table::iterator i = entries.find(Key{ qx, qy, radius });
+                if (i != entries.end() && i->second.middle.distance(p) <= i->second.reach)
+                    entries.erase(i);
+            }
+        }
+    }
+}
+
+template <class Obj>
+void NearbyCache<Obj>::forget_all_near(const Point& p) {
+    for (typename Table::iterator i = entries.begin(); i != entries.end(); ) {
+        if (i->second.middle.distance(p) <= i->second.reach) {
+            i = entries.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+#endif /* !(_NearbyCache_h) */
@@ -1,10 +1,13 @@
 #if !(_ObjInfo_h)
 #define _ObjInfo_h 1
 #include <string>
+#include <type_traits>
+
+#include "Species.h"
 
 //#include "Default_ops.h"
 struct ObjInfo {
-  std::string species;               // species of the object
+  Species species;              // species of the object
   double health;                // their health
   double distance;              // distance between us
   double bearing;               // course I can take to get where it is now
@@ -18,19 +21,17 @@ struct ObjInfo {
       their_course == o.their_course;
   };
 
-  void copy(const ObjInfo& o) { // this is exactly what the default copy
-                                // constructor would do.
-    species = o.species;
-    health = o.health;
-    distance = o.distance;
-    bearing = o.bearing;
-    their_speed = o.their_speed;
-    their_course = o.their_course;
-  }
+  /* the name of their species, without making a copy of it */
+  const std::string& species_name(void) const { return species.name(); }
+
+  /* species comparisons */
+  bool is(Species s) const { return species == s; }
+  bool same_species(const ObjInfo& o) const { return species == o.species; }
 
   ObjInfo(void) {} // use this constructor with care!
-  ObjInfo(const ObjInfo& o) { copy(o); }
-  ObjInfo& operator=(const ObjInfo& o) { copy(o); return *this; }
 };
 
+/* perception results are plain data: copying them never allocates */
+static_assert(std::is_trivially_copyable<ObjInfo>::value, "ObjInfo must be trivially copyable");
+
 #endif /* !(_ObjInfo_h) */
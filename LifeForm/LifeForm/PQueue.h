@@ -0,0 +1,113 @@
+#if !(_PQueue_h)
+#define _PQueue_h 1
+
+#include <algorithm>
+#include <vector>
+
+#include "Event.h"
+
+struct EventCompare {
+  bool operator()(const Event* ep1, const Event* ep2) {
+    if (ep1->t != ep2->t)
+      return ep1->t > ep2->t;   // backwards on purpose so that events 
+                                // are processed in increasing order
+    return ep1->seq > ep2->seq;
+  }
+};
+
+/*
+ * The event queue of one World.
+ * It used to be private to Event.cpp, it lives in a header now so that
+ * each World can hold its own queue.
+ */
+class PQueue {
+	std::vector<Event*> V;
+	template <typename F>
+	void each_at(size_t k, SimTime t, F& f) const {
+		if (k >= V.size() || V[k]->t != t) return;
+		f(V[k]);
+		each_at(2 * k + 1, t, f);
+		each_at(2 * k + 2, t, f);
+	}
+public:
+	PQueue(void) {} // normal construction
+	~PQueue(void) { clear(); }
+  
+	void insert(Event* e) {
+		V.push_back(e);
+		push_heap(V.begin(), V.end(), EventCompare());
+	}
+
+	Event* pop_greatest(void) {
+		pop_heap(V.begin(), V.end(), EventCompare());
+		Event* e = V.back();
+		V.pop_back();
+		return e;
+	}
+
+  
+  /*
+   * remove an event from the queue
+   */
+  void remove(Event* e) {
+	  e->cancel();
+  }
+
+  /* the time of the next event (the queue must not be empty) */
+  SimTime next_time(void) const {
+    return V.front()->t;
+  }
+
+  /*
+   * call f(e) for every event at time t, if that is the time of the next
+   * event (they are at the top of the heap, so only they are looked at)
+   */
+  template <typename F>
+  void each_at(SimTime t, F f) const {
+    each_at(0, t, f);
+  }
+
+  /*
+   * move every event for which take_it returns true from the queue to
+   * 'out' (in no particular order)
+   */
+  template <typename Predicate>
+  void take(Predicate take_it, std::vector<Event*>& out) {
+    auto rest = std::partition(V.begin(), V.end(),
+                               [&take_it](Event* e) { return !take_it(e); });
+    if (rest == V.end()) return;
+    for (auto i = rest; i != V.end(); ++i) {
+      (*i)->in_queue = false;
+    }
+    out.insert(out.end(), rest, V.end());
+    V.erase(rest, V.end());
+    std::make_heap(V.begin(), V.end(), EventCompare());
+  }
+
+  /*
+   * the events, in the order of the heap, so that a TimeWarp can save the
+   * queue and later assign it back (with the events as they were then)
+   */
+  const std::vector<Event*>& contents(void) const { return V; }
+  void assign(const std::vector<Event*>& saved) { V = saved; }
+
+  unsigned size(void) const {
+    return V.end() - V.begin();
+  }
+
+  /*
+   * delete all of the events, without running them.
+   * deleting an event destroys its handler, which may destroy the last
+   * SmartPointer to a LifeForm, so the events are taken out of V first
+   */
+  void clear(void) {
+    std::vector<Event*> doomed;
+    doomed.swap(V);
+    for (Event* e : doomed) {
+      e->in_queue = false;
+      delete e;
+    }
+  }
+};
+
+#endif /* !(_PQueue_h) */
@@ -0,0 +1,66 @@
+#if !(_Packet_h)
+#define _Packet_h 1
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Point.h"
+
+/*
+ * Class name: Packet
+ * Description:
+ *  The bytes of one message between the shards of a ShardedWorld, or of
+ *  one checkpoint (see Checkpoint.h), written and read in the same order.
+ *  Only things that can be copied byte for byte (numbers, Points,
+ *  RandomStreams, ...) and strings are put in a Packet.  Reading past
+ *  the end gives zeros, and makes ok() false.
+ */
+class Packet {
+public:
+    std::vector<char> bytes;
+
+    template <typename T>
+    void put(const T& x) {
+        const char* p = reinterpret_cast<const char*>(&x);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+    void put_string(const std::string& s) {
+        put((uint32_t) s.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+    void put_point(const Point& p) {
+        put(p.xpos);
+        put(p.ypos);
+    }
+
+    template <typename T>
+    T get(void) {
+        T x{};
+        if (at + sizeof(T) <= bytes.size()) memcpy(&x, &bytes[at], sizeof(T));
+        at += sizeof(T);
+        return x;
+    }
+    std::string get_string(void) {
+        uint32_t n = get<uint32_t>();
+        if (!ok() || at + n > bytes.size()) {
+            at = bytes.size() + 1;
+            return std::string();
+        }
+        at += n;
+        return std::string(&bytes[at - n], n);
+    }
+    Point get_point(void) {
+        double x = get<double>();
+        return Point(x, get<double>());
+    }
+
+    bool ok(void) const { return at <= bytes.size(); }
+    bool done(void) const { return at == bytes.size(); }   // everything has been read
+    void clear(void) { bytes.clear(); at = 0; }
+
+private:
+    size_t at = 0;
+};
+
+#endif /* !(_Packet_h) */
@@ -78,6 +78,10 @@ const double min_reproduce_time = 1.0;
 const double Algae_energy_gain = 2.0;
 const SimTime algae_photo_time = 5.0;
 
+/* spores (see Params.h) */
+const unsigned algae_spores = 1;
+const unsigned spore_tries = 8;
+
 /*
  * two objects whos' centers are encounter_distance away (or closer)
  * are considered to have collided.
@@ -121,6 +125,9 @@ const double max_speed = 10.0;
 const double max_perceive_range = 100.0;
 const double min_perceive_range = 2.0;
 
+/* the fewest perceive queries at one instant that are swept together */
+const unsigned sweep_min = 4;
+
 const int grid_max = 500;
 const int win_x_size = 500;
 const int win_y_size = 500;
@@ -146,3 +153,22 @@ const SimulationTerminationStrategy termination_strategy =
 // RUN_TILL_ONE_SPECIES_LEFT;
 // RUN_TILL_HALF_EXTINCT;
 RUN_TILL_EVENTS_EXHAUSTED;      // probably runs forever, Algae Spores
+
+/* the order of the living LifeForms in World::all_life */
+const LiveOrder live_order =
+// SPATIAL_ORDER;
+// SPECIES_ORDER;
+ANY_ORDER;
+
+/* for a TiledWorld: Craig perceives 20.0 */
+const double tile_lookahead = 1.0;
+const double tile_sight = 20.0;
+
+/* for a TimeWarp */
+const double tw_window = 5.0;
+
+/* for animals -c */
+const double checkpoint_interval = 1000.0;
+
+/* for TRACE_PROBES */
+const char* const probe_target = "probes.json";
@@ -83,6 +83,15 @@ extern const double min_reproduce_time;
 extern const double Algae_energy_gain;
 extern const SimTime algae_photo_time;
 
+/*
+ * with ALGAE_SPORES, algae_spores Algae are made every time unit, each
+ * where it doesn't touch anything.  A spore tries spore_tries random
+ * places before the rest of the batch is placed with a FreeSpace (see
+ * FreeSpace.h), and if there is no room at all, fewer are made
+ */
+extern const unsigned algae_spores;
+extern const unsigned spore_tries;
+
 /*
  * two objects whos' centers are encounter_distance away (or closer)
  * are considered to have collided.
@@ -123,6 +132,13 @@ extern const double max_speed;
 extern const double max_perceive_range;
 extern const double min_perceive_range;
 
+/*
+ * with PERCEIVE_SWEEP, when at least sweep_min LifeForms perceive at the
+ * same instant (in events of kinds that say so, see Event::add_kind),
+ * they are answered together (see PerceiveSweep.h)
+ */
+extern const unsigned sweep_min;
+
 extern const int grid_max;
 extern const int win_x_size;
 extern const int win_y_size;
@@ -160,4 +176,49 @@ enum SimulationTerminationStrategy {
 
 extern const SimulationTerminationStrategy termination_strategy;
 
+/*
+ * the order of the living LifeForms in World::all_life.  Passes over
+ * the whole population (e.g., advance_all) touch less memory when
+ * neighbors are stored next to each other.  The order is restored once
+ * per redisplay, objects that are born in between are simply appended.
+ */
+enum LiveOrder {
+  ANY_ORDER,                    // whatever order births and deaths leave
+  SPATIAL_ORDER,                // along a Z curve through the grid
+  SPECIES_ORDER                 // grouped by species
+};
+
+extern const LiveOrder live_order;
+
+/*
+ * a TiledWorld (animals -t N) runs its tiles in parallel for
+ * tile_lookahead time units at a time, and then brings them together
+ * to exchange LifeForms.  Each tile sees copies (ghosts) of the LifeForms
+ * of its neighbors that are within tile_sight + encounter_distance
+ * + 2 * max_speed * tile_lookahead of its border, so tile_sight should
+ * be the farthest that any species perceives (at most max_perceive_range)
+ */
+extern const double tile_lookahead;
+extern const double tile_sight;
+
+/*
+ * a TimeWarp (animals -T N) runs its logical processes optimistically
+ * for tw_window time units between commits, rolling back whatever turns
+ * out to be wrong.  The longer the window, the fewer barriers (and the
+ * staler the ghosts, and the more there may be to roll back)
+ */
+extern const double tw_window;
+
+/*
+ * animals -c saves a checkpoint (see Checkpoint.h) every
+ * checkpoint_interval time units, at the first redisplay after
+ */
+extern const double checkpoint_interval;
+
+/*
+ * a program built with TRACE_PROBES=1 writes the timings of its probes
+ * (see Probe.h) to this file when it exits
+ */
+extern const char* const probe_target;
+
 #endif /* !(_Params_h) */
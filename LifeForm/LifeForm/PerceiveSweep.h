@@ -0,0 +1,166 @@
+#if !(_PerceiveSweep_h)
+#define _PerceiveSweep_h 1
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Point.h"
+#include "QuadTree.h"
+#include "SimTime.h"
+
+/*
+ * Class name: PerceiveSweep
+ * Description:
+ *  The answers to the perceive queries that are due at one simulated
+ *  instant, found together before any of them is asked (e.g., a crowd
+ *  of hunters that all wake up together, see Event::add_kind).  The
+ *  circles are sorted along a Z-order curve, so that neighbors are next
+ *  to each other, and answered with one walk of the tree
+ *  (QuadTree::visit_within_each) instead of one walk from the root each.
+ *
+ *  An answer is handed out by visit_nearby, which visits exactly what
+ *  QuadTree::visit_nearby would have, in the same order, so a sweep
+ *  never changes the results.  An answer whose circle covers a point
+ *  where the tree has changed since the sweep (QuadTree::changes_since)
+ *  is dropped, and then visit_nearby says false and the caller asks the
+ *  tree itself.  Since the answers are in Z-order, the ones a change can
+ *  reach are found with a few binary searches (forget_near), not by
+ *  looking at all of them.  The answers that are left are let go of (clear) when
+ *  the instant is over, so that they don't keep the dead alive.
+ */
+template <class Obj>
+class PerceiveSweep {
+public:
+    /* answer every (center, radius) in circles at time now (circles is
+       sorted in the process) */
+    void sweep(const QuadTree<Obj>& tree, std::vector<std::pair<Point, double>>& circles,
+               SimTime now);
+
+    /* call visit(obj) for each object of the answer for (center, radius),
+       if the last sweep found one at now that is still good; false if not */
+    template <typename Visitor>
+    bool visit_nearby(const QuadTree<Obj>& tree, const Point& center, double radius,
+                      SimTime now, Visitor visit);
+
+    SimTime when(void) const { return time; }   // the instant of the last sweep
+    bool holds(void) const { return !answers.empty(); }
+    void skip(SimTime now) { time = now; answers.clear(); }     // no sweep at now
+    void clear(void) { skip(-1.0); }            // let go of the answers (and what they found)
+
+private:
+    struct Answer {
+        uint64_t z;             // z_order(center), which they are sorted by
+        Point center;
+        double radius;
+        bool valid;
+        std::vector<std::pair<Obj, Point>> found;
+    };
+
+    SimTime time = -1.0;
+    unsigned long version = 0;
+    std::vector<Answer> answers;        // in the order of the circles
+    double max_radius = 0.0;            // of any of the answers
+
+    void forget_near(const Point&);
+
+    static uint32_t cell(double c) { return (uint32_t) std::min(std::max(0.0, c), 4294967295.0); }
+    static uint64_t z_order(uint32_t x, uint32_t y);
+    static uint64_t z_order(const Point& p) { return z_order(cell(p.xpos), cell(p.ypos)); }
+};
+
+template <class Obj>
+void PerceiveSweep<Obj>::sweep(const QuadTree<Obj>& tree,
+                               std::vector<std::pair<Point, double>>& circles, SimTime now) {
+    time = now;
+    version = tree.version();
+    std::sort(circles.begin(), circles.end(),
+              [](const std::pair<Point, double>& a, const std::pair<Point, double>& b) {
+                  return z_order(a.first) < z_order(b.first);
+              });
+    answers.resize(circles.size());
+    max_radius = 0.0;
+    for (size_t k = 0; k < circles.size(); k += 1) {
+        max_radius = std::max(max_radius, circles[k].second);
+        answers[k].z = z_order(circles[k].first);
+        answers[k].center = circles[k].first;
+        answers[k].radius = circles[k].second;
+        answers[k].valid = true;
+        answers[k].found.clear();
+    }
+    tree.visit_within_each(circles, [this](unsigned k, const Obj& obj, const Point& pos) {
+        answers[k].found.push_back(std::make_pair(obj, pos));
+    });
+}
+
+template <class Obj>
+template <typename Visitor>
+bool PerceiveSweep<Obj>::visit_nearby(const QuadTree<Obj>& tree, const Point& center,
+                                      double radius, SimTime now, Visitor visit) {
+    if (now != time || answers.empty()) return false;
+    if (tree.version() != version) {
+        bool known = tree.changes_since(version, [this](const Point& p) { forget_near(p); });
+        if (!known) {
+            answers.clear();
+            return false;
+        }
+        version = tree.version();
+    }
+
+    uint64_t z = z_order(center);
+    auto a = std::lower_bound(answers.begin(), answers.end(), z,
+                              [](const Answer& x, uint64_t z) { return x.z < z; });
+    for (; a != answers.end() && a->z == z; ++a) {
+        if (a->center.xpos != center.xpos || a->center.ypos != center.ypos
+            || a->radius != radius) continue;
+        if (!a->valid) return false;
+        a->valid = false;           // (each one is asked once)
+        for (const auto& f : a->found) {
+            if (f.second != center) visit(f.first);
+        }
+        a->found.clear();           // (not keeping anything alive)
+        return true;
+    }
+    return false;
+}
+
+/*
+ * drop the answers whose circles cover p.  Their centers are in the
+ * square of cells within max_radius of p, and an aligned block of
+ * side s (a power of two) is one run of the Z-order, so with s at least
+ * as wide as the square, the (at most four) blocks that it touches are
+ * found with a binary search each
+ */
+template <class Obj>
+void PerceiveSweep<Obj>::forget_near(const Point& p) {
+    uint64_t x0 = cell(p.xpos - max_radius), x1 = cell(p.xpos + max_radius);
+    uint64_t y0 = cell(p.ypos - max_radius), y1 = cell(p.ypos + max_radius);
+    uint64_t s = 1;
+    while (s <= x1 - x0 || s <= y1 - y0) s <<= 1;
+    for (uint64_t bx = x0 / s; bx <= x1 / s; bx += 1) {
+        for (uint64_t by = y0 / s; by <= y1 / s; by += 1) {
+            uint64_t first = z_order((uint32_t) (bx * s), (uint32_t) (by * s));
+            uint64_t last = z_order((uint32_t) (bx * s + s - 1), (uint32_t) (by * s + s - 1));
+            auto a = std::lower_bound(answers.begin(), answers.end(), first,
+                                      [](const Answer& x, uint64_t z) { return x.z < z; });
+            for (; a != answers.end() && a->z <= last; ++a) {
+                if (a->valid && a->center.distance(p) <= a->radius) a->valid = false;
+            }
+        }
+    }
+}
+
+/* the bits of the x and y cells (of a unit grid) interleaved */
+template <class Obj>
+uint64_t PerceiveSweep<Obj>::z_order(uint32_t x, uint32_t y) {
+    uint64_t z = 0;
+    for (unsigned b = 0; b < 32; b += 1) {
+        z |= (uint64_t) ((x >> b) & 1) << (2 * b);
+        z |= (uint64_t) ((y >> b) & 1) << (2 * b + 1);
+    }
+    return z;
+}
+
+#endif /* !(_PerceiveSweep_h) */
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "Params.h"
+#include "Probe.h"
+
+using namespace std;
+
+thread_local Probe::Ring* Probe::ring = nullptr;
+
+/* every thread's Ring, and when the first one was made */
+struct ProbeRegistry {
+    mutex lock;
+    vector<unique_ptr<Probe::Ring>> rings;
+    uint64_t first_ticks = 0;
+    chrono::steady_clock::time_point first_time;
+};
+
+static ProbeRegistry& registry(void) {
+    static ProbeRegistry the_registry;
+    return the_registry;
+}
+
+static void write_at_exit(void) {
+    Probe::write(probe_target);
+}
+
+Probe::Ring* Probe::join(void)
+{
+    ProbeRegistry& r = registry();
+    lock_guard<mutex> hold(r.lock);
+    if (r.rings.empty()) {
+        r.first_ticks = ticks();
+        r.first_time = chrono::steady_clock::now();
+        atexit(write_at_exit);      // (after the registry, so it is still there)
+    }
+    r.rings.emplace_back(new Ring((unsigned) r.rings.size()));
+    ring = r.rings.back().get();
+    return ring;
+}
+
+/*
+ * ticks are turned into microseconds (what a Chrome trace counts in) by
+ * how many of them went by between the first probe and now
+ */
+bool Probe::write(const string& target)
+{
+    ProbeRegistry& r = registry();
+    lock_guard<mutex> hold(r.lock);
+    if (r.rings.empty()) return true;
+
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - r.first_time).count();
+    uint64_t elapsed = ticks() - r.first_ticks;
+    double per_us = us > 0.0 && elapsed > 0 ? elapsed / us : 1000.0;
+
+    FILE* out = fopen(target.c_str(), "w");
+    if (out == nullptr) {
+        cerr << "Probe: cannot write " << target << "\n";
+        return false;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char* comma = "";
+    for (const unique_ptr<Ring>& ring : r.rings) {
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"thread %u\"}}", comma, ring->thread, ring->thread);
+        comma = ",\n";
+        uint64_t count = ring->count.load(memory_order_acquire);
+        uint64_t first = count > ring_size ? count - ring_size : 0;
+        for (uint64_t k = first; k < count; k += 1) {
+            const Sample& s = ring->samples[k & (ring_size - 1)];
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    comma, s.name, ring->thread, (s.start - r.first_ticks) / per_us,
+                    (s.end - s.start) / per_us);
+        }
+    }
+    fprintf(out, "\n]}\n");
+    if (fclose(out) != 0) {
+        cerr << "Probe: cannot write " << target << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,104 @@
+#if !(_Probe_h)
+#define _Probe_h 1
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/*
+ * Class name: Probe
+ * Description:
+ *  Times a block of the simulator, e.g.
+ *      void Event::do_next(void) {
+ *          PROBE("Event::do_next");
+ *          ...
+ *  PROBE is nothing at all unless the program is built with
+ *  TRACE_PROBES=1 (see the Makefile).  Then it reads the time stamp
+ *  counter on the way in and on the way out, and puts the pair in a ring
+ *  buffer of the thread it runs on: no locks, no system calls and no
+ *  allocation (except the ring itself, the first time a thread uses a
+ *  probe), so a probe costs a few ns.  A ring keeps the last ring_size
+ *  samples of its thread, older ones are overwritten.
+ *
+ *  When the program exits, every thread's samples are written to
+ *  probe_target (see Params.cpp) as a Chrome trace (Trace Event
+ *  Format, "X" events), to be opened with chrome://tracing or Perfetto:
+ *  one row per thread, nested probes nested.  A probe that is still
+ *  open then isn't written.  The processes of a ShardedWorld leave with
+ *  _exit, so only the coordinator's probes are written.
+ *
+ *  Only string literals (or other strings that live as long as the
+ *  program) can be probe names: a sample keeps the pointer.
+ */
+#if (TRACE_PROBES)
+#define PROBE_JOIN2(a, b) a##b
+#define PROBE_JOIN(a, b) PROBE_JOIN2(a, b)
+#define PROBE(name) Probe PROBE_JOIN(probe_, __LINE__)(name)
+#else
+#define PROBE(name) ((void) 0)
+#endif /* TRACE_PROBES */
+
+class Probe {
+public:
+    explicit Probe(const char* name) : name(name), start(ticks()) {}
+    ~Probe(void) { record(name, start, ticks()); }
+
+    /* the time stamp counter (or a clock in ns, where there is none) */
+    static uint64_t ticks(void) {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /* write every thread's samples so far (at exit, to probe_target);
+       false if the file can't be written */
+    static bool write(const std::string& target);
+
+private:
+    static const size_t ring_size = 1 << 17;    // samples per thread, a power of 2
+
+    struct Sample {
+        const char* name;
+        uint64_t start, end;
+    };
+
+    /* (only its own thread writes it, and it is only read at exit) */
+    struct Ring {
+        std::vector<Sample> samples;
+        std::atomic<uint64_t> count{ 0 };       // samples ever put
+        unsigned thread;                        // numbered in the order they first probed
+        Ring(unsigned t) : samples(ring_size), thread(t) {}
+    };
+
+    static thread_local Ring* ring;
+    static Ring* join(void);    // a Ring for this thread
+
+    static void record(const char* name, uint64_t start, uint64_t end) {
+        Ring* r = ring ? ring : join();
+        uint64_t n = r->count.load(std::memory_order_relaxed);
+        r->samples[n & (ring_size - 1)] = Sample{ name, start, end };
+        r->count.store(n + 1, std::memory_order_release);
+    }
+
+    const char* name;
+    uint64_t start;
+
+    Probe(const Probe&) = delete;
+    void operator=(const Probe&) = delete;
+
+    friend struct ProbeRegistry;
+};
+
+#endif /* !(_Probe_h) */
@@ -82,10 +82,13 @@
  */
 
 
+#include <algorithm>
 #include <cassert>
 #include <utility>
 #include <vector>
+#include "FreeSpace.h"
 #include "Point.h"
+#include "Probe.h"
 
 template <class Obj> class TreeNode; // used for implementation of the QuadTree
 
@@ -96,6 +99,10 @@ template <class Obj>
    */
 class QuadTree {
   TreeNode<Obj>* root;
+  unsigned long changes;        // bumped by every insert, remove and move
+  static const unsigned journal_size = 64;
+  Point journal[journal_size];  // where the last journal_size changes were,
+                                // journal[changes % journal_size] is next
   Point uleft, lright;          // not really needed, as "root" duplicates
                                 // this data, but having the copies of the 
                                 // boundary points is convenient
@@ -112,11 +119,29 @@ public:
                                 // which 'is_out_of_bounds'.
   void insert(const Obj&, const Point& pos, std::function<void(void)> = [](){});
 
+  void insert_all(const std::vector<std::pair<Obj,Point>>&,
+                  std::function<void(const Obj&)> resize);
+                                // insert many objects at once, resize(obj)
+                                // being each one's callback.  As with
+                                // update_positions, the callbacks of objects
+                                // whose regions shrink are held back until
+                                // every object is in
+
+  void restore(const Obj&, const Point& pos, std::function<void(void)> resize);
+                                // insert, without invoking the callback of
+                                // an object whose region shrinks (when a
+                                // tree is rebuilt as it was, see TimeWarp)
+
+  void clear(void);             // remove every object, without invoking any
+                                // callbacks
+
   Obj remove(const Point&);
                                 // find the identical object 'x' in the tree
                                 // and remove it.  It is an error to attempt
                                 // to remove an object that is not in the tree
 
+  bool empty(void) const { return root->is_empty(); }
+
   Obj closest(const Point&) const;    // find the (cartesian distance) closest Obj 
                                 // to the specified point.  The QuadTree must
                                 // not be empty (i.e., there must be a closest
@@ -129,6 +154,53 @@ public:
                                 // circle is not included in the list
                                 // (objects are not "nearby" to themselves)
 
+  template <typename Visitor>
+  void visit_nearby(const Point& center, double radius, Visitor visit) const {
+    PROBE("QuadTree::nearby");
+    auto not_center = [&center, &visit](const Obj& obj, const Point& pos) {
+      if (pos != center) visit(obj);
+    };
+    root->visit_within(center, radius, not_center);
+  }
+                                // call visit(obj) for each Obj that nearby
+                                // would return, without building the vector.
+                                // visit must not modify the QuadTree
+
+  template <typename Visitor>
+  void visit_within(const Point& center, double radius, Visitor visit) const {
+    root->visit_within(center, radius, visit);
+  }
+                                // call visit(obj, position) for each Obj
+                                // inside the circle, including an object
+                                // at the center of the circle (if any).
+                                // visit must not modify the QuadTree
+
+  template <typename Uniform>
+  bool free_point(const Point& center, double radius, double clearance,
+                  Uniform uniform, Point& where) const;
+                                // a random point inside the tree, within
+                                // radius of center and farther than
+                                // clearance from every object (e.g. for a
+                                // child), found with one visit of the objects
+                                // near the circle and a FreeSpace (see
+                                // FreeSpace.h); false if there is none.
+                                // uniform() gives numbers in [0, 1)
+
+  template <typename Visitor>
+  void visit_within_each(const std::vector<std::pair<Point,double>>& circles,
+                         Visitor visit) const {
+    PROBE("QuadTree::visit_within_each");
+    std::vector<unsigned> active;
+    for (unsigned k = 0; k < circles.size(); k++) active.push_back(k);
+    root->visit_within_each(circles, active, 0, visit);
+  }
+                                // visit_within for each of the circles
+                                // (center, radius) at once, with one walk
+                                // of the tree: call visit(k, obj, position)
+                                // for each Obj inside circle k.  Each
+                                // circle's objects come in the order that
+                                // visit_within would visit them
+
   bool is_out_of_bounds(const Point&) const; // return true iff the Point is outside 
                                 // the boundaries of this QuadTree
 
@@ -142,15 +214,56 @@ public:
 
   void update_position(const Point&, const Point&) ;
   // updates position of object to new position
+
+  void update_positions(const std::vector<std::pair<Point,Point>>&);
+                                // move many objects at once, each pair is
+                                // (old position, new position).  The resize
+                                // callbacks are held back until every object
+                                // has been moved, so each callback sees the
+                                // final shape of the tree
+
+  unsigned depth(void) const { return root->depth(); }
+                                // the number of levels below the root
+                                // of the deepest leaf
+
+  unsigned long version(void) const { return changes; }
+                                // changes whenever the contents of the tree
+                                // change, so that answers to earlier queries
+                                // can be recognized as stale
+
+  template <typename F>
+  bool changes_since(unsigned long since, F each) const {
+    if (changes - since > journal_size) return false;
+    for (unsigned long k = since; k != changes; k++) {
+      each(journal[k % journal_size]);
+    }
+    return true;
+  }
+                                // call each(point) for every point where
+                                // an object was inserted, removed, or moved
+                                // from or to since version() was 'since'.
+                                // returns false (and calls nothing) if the
+                                // tree has changed too much to remember
+
+  const Point& upper_left(void) const { return uleft; }
+  const Point& lower_right(void) const { return lright; }
    
 
   QuadTree(double xmin, double ymin, double xmax, double ymax) {
     uleft = Point(xmin,ymax);
     lright = Point(xmax,ymin);
     root = new TreeNode<Obj>(uleft, lright); 
+    changes = 0;
   }
 
   ~QuadTree(void);
+
+private:
+  void move(const Point&, const Point&, std::vector<std::function<void(void)>>&);
+  void note_change(const Point& p) {
+    journal[changes % journal_size] = p;
+    changes += 1;
+  }
 };
 
 template <class Obj> 
@@ -209,6 +322,8 @@ class TreeNode {
       }
     }
     assert(k < 4);
+    obj = Obj();                // the child has them now
+    resize_event = std::function<void(void)>();
   }
 
   void merge() {
@@ -330,6 +445,14 @@ public:
   }
 
   bool is_leaf(void) const { return child == (const TNPtr*) 0; }
+  unsigned depth(void) const {
+    unsigned d = 0;
+    if (is_leaf()) return d;
+    for (unsigned k = 0; k < 4; k++) {
+      d = std::max(d, child[k]->depth() + 1);
+    }
+    return d;
+  }
 
   bool is_empty(void) const { return (num_objects == 0) && is_leaf(); }
 
@@ -381,6 +504,7 @@ public:
       }
       assert(pos == obj_pos);
       oldobj = obj;
+      obj = Obj();              // don't keep a reference to a removed object
       resize_event = std::function<void(void)>();
       num_objects -= 1;
     }
@@ -415,18 +539,64 @@ public:
    */
   void find_nearby(std::vector<Obj>& list, const Point& center, 
                    double dist) const {
+    auto add = [&list, &center](const Obj& obj, const Point& pos) {
+      if (pos != center) list.push_back(obj);
+    };
+    visit_within(center, dist, add);
+  }
+
+  /*
+   * invoke visit(obj, obj_pos) on every object that is inside this region
+   * and not more than 'dist' units away from 'center' (this includes
+   * an object at 'center')
+   */
+  template <typename Visitor>
+  void visit_within(const Point& center, double dist, Visitor& visit) const {
     if (is_empty()) return;
     if (! intersects(center, dist)) return;
 
     if (num_objects == 1) {
-      if (obj_pos != center && center.distance(obj_pos) <= dist)
-        list.push_back(obj);
+      if (center.distance(obj_pos) <= dist)
+        visit(obj, obj_pos);
     }
     else {
       for (unsigned k = 0; k < 4; k++) {
-        child[k]->find_nearby(list, center, dist);
+        child[k]->visit_within(center, dist, visit);
+      }
+    }
+  }
+
+  /*
+   * visit_within for many circles in one walk: invoke visit(k, obj,
+   * obj_pos) for every object inside this region and circle k, for each
+   * k in active[from..] (the circles that reach the parent).  active is
+   * used as a stack, and is left as it was
+   */
+  template <typename Visitor>
+  void visit_within_each(const std::vector<std::pair<Point,double>>& circles,
+                         std::vector<unsigned>& active, size_t from, Visitor& visit) const {
+    if (is_empty()) return;
+    size_t here = active.size();
+    for (size_t i = from; i < here; i++) {
+      const std::pair<Point,double>& c = circles[active[i]];
+      if (intersects(c.first, c.second)) active.push_back(active[i]);
+    }
+
+    if (active.size() > here) {
+      if (num_objects == 1) {
+        for (size_t i = here; i < active.size(); i++) {
+          const std::pair<Point,double>& c = circles[active[i]];
+          if (c.first.distance(obj_pos) <= c.second)
+            visit(active[i], obj, obj_pos);
+        }
+      }
+      else {
+        for (unsigned k = 0; k < 4; k++) {
+          child[k]->visit_within_each(circles, active, here, visit);
+        }
       }
     }
+    active.resize(here);
   }
 
   /*
@@ -529,15 +699,65 @@ template <class Obj>
 void QuadTree<Obj>::insert(const Obj& obj, const Point& pos, 
                            std::function<void(void)> resize) {
   std::function<void(void)> callback = [](){};
+  note_change(pos);
   bool is_ok = root->insert(obj, pos, resize, callback);
   assert(is_ok);
   callback();
 }
          
+template <class Obj>
+void QuadTree<Obj>::insert_all(const std::vector<std::pair<Obj,Point>>& objs,
+                               std::function<void(const Obj&)> resize) {
+  PROBE("QuadTree::insert_all");
+  std::vector<std::function<void(void)>> callbacks;
+  for (const auto& o : objs) {
+    std::function<void(void)> callback;
+    Obj obj = o.first;
+    note_change(o.second);
+    bool is_ok = root->insert(obj, o.second, [resize, obj](void) { resize(obj); }, callback);
+    assert(is_ok);
+    if (callback) callbacks.push_back(callback);
+  }
+
+  /* every object is in, the tree is stable, invoke the callbacks */
+  for (auto& callback : callbacks) callback();
+}
+
+template <class Obj>
+template <typename Uniform>
+bool QuadTree<Obj>::free_point(const Point& center, double radius, double clearance,
+                               Uniform uniform, Point& where) const {
+  PROBE("QuadTree::free_point");
+  FreeSpace space(Point(center.xpos - radius, center.ypos - radius), 2.0 * radius, clearance);
+  auto occupy = [&space](const Obj&, const Point& at) { space.occupy(at); };
+  /* (nothing farther away can be within clearance of the circle) */
+  root->visit_within(center, radius + clearance, occupy);
+  return space.take(uniform, where, [this, &center, radius](const Point& p) {
+    return p.distance(center) <= radius && !is_out_of_bounds(p);
+  });
+}
+
+template <class Obj>
+void QuadTree<Obj>::restore(const Obj& obj, const Point& pos,
+                            std::function<void(void)> resize) {
+  std::function<void(void)> callback = [](){};
+  note_change(pos);
+  bool is_ok = root->insert(obj, pos, resize, callback);
+  assert(is_ok);
+}
+
+template <class Obj>
+void QuadTree<Obj>::clear(void) {
+  delete root;
+  root = new TreeNode<Obj>(uleft, lright);
+  changes += journal_size + 1;  // too many changes to remember
+}
+
 template <class Obj>
 Obj QuadTree<Obj>::remove(const Point& pos) {
   std::function<void(void)> callback = [](){};
   Obj result;
+  note_change(pos);
   bool is_ok = root->remove(pos, result, callback);
   assert(is_ok);
   callback();
@@ -546,6 +766,7 @@ Obj QuadTree<Obj>::remove(const Point& pos) {
 
 template <class Obj>
 Obj QuadTree<Obj>::closest(const Point& pos) const {
+  PROBE("QuadTree::closest");
   double dist = HUGE;
   std::pair<bool,Obj> tmp = root->closest(pos, dist);
   assert(tmp.first);
@@ -554,6 +775,7 @@ Obj QuadTree<Obj>::closest(const Point& pos) const {
 
 template <class Obj>
 std::vector<Obj> QuadTree<Obj>::nearby(const Point& pos, double dist) const {
+  PROBE("QuadTree::nearby");
   std::vector<Obj> result;
   root->find_nearby(result, pos, dist);
   return result;
@@ -609,7 +831,36 @@ bool QuadTree<Obj>::is_occupied(const Point& pos) const {
 template <class Obj>
 void QuadTree<Obj>::update_position(const Point& pos_old, 
                                     const Point& pos_new) {
-  
+  PROBE("QuadTree::update_position");
+  std::vector<std::function<void(void)>> callbacks;
+  move(pos_old, pos_new, callbacks);
+
+  /* now the tree is stable, invoke the callbacks */
+  for (auto& callback : callbacks) callback();
+}
+
+template <class Obj>
+void QuadTree<Obj>::update_positions(const std::vector<std::pair<Point,Point>>& moves) {
+  PROBE("QuadTree::update_positions");
+  std::vector<std::function<void(void)>> callbacks;
+  for (const auto& m : moves) {
+    move(m.first, m.second, callbacks);
+  }
+
+  /* every object has moved, the tree is stable, invoke the callbacks */
+  for (auto& callback : callbacks) callback();
+}
+
+/*
+ * move the object at pos_old to pos_new.  The resize callbacks that
+ * must be invoked as a result are appended to 'callbacks', the caller
+ * invokes them once the tree is stable
+ */
+template <class Obj>
+void QuadTree<Obj>::move(const Point& pos_old, const Point& pos_new,
+                         std::vector<std::function<void(void)>>& callbacks) {
+  note_change(pos_old);
+  note_change(pos_new);
   std::pair<TreeNode<Obj>*, TreeNode<Obj>*> res = root->find_leaf(pos_old);
   TreeNode<Obj>* leaf = res.first;
   TreeNode<Obj>* parent = res.second;
@@ -647,8 +898,8 @@ void QuadTree<Obj>::update_position(const Point& pos_old,
                                     obj_callback, insert_callback);
     assert(insert_ok);
 
-    /* tree is now stable, invoke the callback from inserting */
-    insert_callback();
+    /* the callback from inserting is invoked once the tree is stable */
+    callbacks.push_back(insert_callback);
   }
   else {                        // case 3: up to two callbacks
     std::function<void(void)> obj_callback = leaf->get_callbk();
@@ -662,9 +913,9 @@ void QuadTree<Obj>::update_position(const Point& pos_old,
     bool insert_ok = root->insert(obj, pos_new, obj_callback, insert_callback);
     assert(insert_ok);
 
-    /* now the tree is stable, invoke both callbacks */
-    remove_callback();
-    insert_callback();
+    /* both callbacks are invoked once the tree is stable */
+    callbacks.push_back(remove_callback);
+    callbacks.push_back(insert_callback);
   }
   
 #ifdef DEBUG_QUADTREE
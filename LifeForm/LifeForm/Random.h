@@ -1,8 +1,53 @@
-#include <random>
-
-#if defined (_MSC_VER)
-namespace epl {
-extern std::default_random_engine random_generator;
-extern std::function<double(void)> drand48;
-}
-#endif
+#if !(_Random_h)
+#define _Random_h 1
+
+#include <cstdint>
+
+/*
+ * Class name: RandomStream
+ * Description:
+ *  A counter-based random number generator.  The n'th number of the
+ *  stream with a given key is splitmix64 of key + n * golden, so all a
+ *  stream holds is its key and how many numbers it has drawn: drawing is
+ *  a few multiplies and shifts, inline at the call, and a stream is
+ *  saved (e.g., in a TimeWarp checkpoint) or sent (to another process)
+ *  by copying two words.
+ *
+ *  Every World and every LifeForm has a stream of its own (see
+ *  LifeForm::drand48), so what a LifeForm draws depends only on its key
+ *  and on how many numbers it has drawn, not on how its draws happened
+ *  to be interleaved with anybody else's.
+ *
+ *  Usage:
+ *      RandomStream r(RandomStream::key(seed, id));
+ *      double x = r.next();        // uniform in [0, 1)
+ */
+class RandomStream {
+public:
+    RandomStream(void) : k(0), count(0) {}
+    explicit RandomStream(uint64_t key) : k(key), count(0) {}
+
+    /* the key of stream 'id' of a simulation with this seed */
+    static uint64_t key(uint64_t seed, uint64_t id) { return mix(mix(seed) ^ (id * golden)); }
+
+    uint64_t next_bits(void) { count += 1; return mix(k + count * golden); }
+    double next(void) { return (double) (next_bits() >> 11) * (1.0 / 9007199254740992.0); }
+
+    bool operator==(const RandomStream& r) const { return k == r.k && count == r.count; }
+    bool operator!=(const RandomStream& r) const { return !(*this == r); }
+
+private:
+    static const uint64_t golden = 0x9e3779b97f4a7c15ull;
+
+    /* the splitmix64 finalizer */
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t k;
+    uint64_t count;             // numbers drawn so far
+};
+
+#endif /* !(_Random_h) */
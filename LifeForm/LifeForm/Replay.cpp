@@ -0,0 +1,337 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include "Replay.h"
+#include "LifeForm.h"
+#include "Packet.h"
+#include "World.h"
+
+using namespace std;
+
+/* a double, kept bit for bit in a uint64_t field of a Record */
+static double value(uint64_t b) {
+    double x;
+    memcpy(&x, &b, sizeof(x));
+    return x;
+}
+
+static const char* what_names[] = {
+    "DISPATCH", "CALL", "BIRTH", "DEATH", "EAT", "ENCOUNTER", "ACTION",
+    "COURSE", "SPEED", "PERCEIVE", "REPRODUCE", "NEW", "ENERGY", "SCHEDULE",
+    "CANCEL", "STREAM"
+};
+
+/*
+ * Class name: Puppet
+ * Description:
+ *  A LifeForm that plays a species in a Replay: everything it does is
+ *  read from its Script.  Its own events are all of one kind (on_act),
+ *  each remembers the kind of the real one it stands for.
+ */
+class Puppet : public LifeForm {
+public:
+    explicit Puppet(const std::string& name);
+    ~Puppet(void);
+
+    Color my_color(void) const { return (Color) (1 + species().index() % 7); }
+    std::string species_name(void) const { return name; }
+    Action encounter(const ObjInfo&);
+
+    static void on_act(LifeForm* p, double) { static_cast<Puppet*>(p)->act(); }
+
+private:
+    /* an event it has scheduled, that hasn't been run yet */
+    struct Pending {
+        Event* event;
+        uint16_t kind;          // the kind in the trace
+    };
+
+    Replay& replay;
+    std::string name;           // "" until it is given to reproduce
+    Replay::Script& script;
+    std::vector<Pending> pending;
+    std::unordered_map<uint64_t, SmartPointer<LifeForm>> made;
+
+    const Replay::Record* expect(Trace::What);  // the next Record, if it is one of those
+    void act(void);
+    void play(void);            // up to the next call
+    void apply(const Replay::Record&);
+    Puppet* find(uint64_t handle);
+
+    friend class Replay;
+};
+
+Puppet::Puppet(const string& n)
+    : replay(*world->replay), name(n), script(replay.scripts[handle])
+{
+    replay.live[handle] = this;
+    play();                     // what its constructor did
+}
+
+Puppet::~Puppet(void)
+{
+    auto i = replay.live.find(handle);
+    if (i != replay.live.end() && i->second == this) replay.live.erase(i);
+}
+
+const Replay::Record* Puppet::expect(Trace::What what)
+{
+    if (replay.left) return nullptr;
+    if (script.next == script.at.size()) {
+        replay.leave(string(what_names[what]) + " by " + to_string(handle) + " isn't in the trace");
+        return nullptr;
+    }
+    const Replay::Record& r = replay.records[script.at[script.next]];
+    if (r.what != what || r.time != world->now) {
+        replay.leave(string(what_names[what]) + " by " + to_string(handle)
+                     + ", but the trace has " + replay.describe(r));
+        return nullptr;
+    }
+    script.next += 1;
+    return &r;
+}
+
+void Puppet::act(void)
+{
+    if (expect(Trace::CALL)) play();
+}
+
+Action Puppet::encounter(const ObjInfo&)
+{
+    if (!expect(Trace::ENCOUNTER)) return LIFEFORM_IGNORE;
+    play();
+    const Replay::Record* r = expect(Trace::ACTION);
+    return r ? (Action) r->a : LIFEFORM_IGNORE;
+}
+
+void Puppet::play(void)
+{
+    while (!replay.left && script.next < script.at.size()) {
+        const Replay::Record& r = replay.records[script.at[script.next]];
+        if (r.what == Trace::CALL || r.what == Trace::ENCOUNTER || r.what == Trace::ACTION) break;
+        script.next += 1;
+        if (r.time != world->now) {
+            replay.leave(replay.describe(r) + " is at another time");
+            break;
+        }
+        apply(r);
+    }
+    made.clear();
+}
+
+Puppet* Puppet::find(uint64_t handle)
+{
+    auto i = replay.live.find(handle);
+    if (i != replay.live.end()) return i->second;
+    replay.leave("there is no LifeForm " + to_string(handle));
+    return nullptr;
+}
+
+/* what the real one did, done again */
+void Puppet::apply(const Replay::Record& r)
+{
+    if (r.what == Trace::NEW) {
+        SmartPointer<LifeForm> child = new Puppet("");
+        if (child->handle != r.target) {
+            replay.leave("LifeForm " + to_string(child->handle) + " was made instead of "
+                         + to_string(r.target));
+        }
+        made[child->handle] = child;
+        return;
+    }
+    Puppet* target = find(r.target);
+    if (target == nullptr) return;
+
+    switch (r.what) {
+        case Trace::COURSE:
+            target->set_course(value(r.a));
+            break;
+        case Trace::SPEED:
+            target->set_speed(value(r.a));
+            break;
+        case Trace::PERCEIVE: {
+            /* what it saw is the trace's business: only the cost is real */
+            double distance = value(r.a);
+            target->pay_to_perceive(distance);
+            break;
+        }
+        case Trace::ENERGY:
+            target->add_energy(value(r.a));
+            break;
+        case Trace::STREAM: {
+            Packet stream;
+            stream.put(r.a);
+            stream.put(r.b);
+            target->random = stream.get<RandomStream>();
+            break;
+        }
+        case Trace::SCHEDULE: {
+            Event* e = new Event(value(r.a), &on_act, target, value(r.b));
+            target->pending.push_back(Pending{ e, r.kind });
+            break;
+        }
+        case Trace::CANCEL:
+            for (const Pending& p : target->pending) {
+                if (p.kind == r.kind && p.event->is_active() && p.event->t == value(r.a)
+                    && p.event->arg == value(r.b)) {
+                    p.event->cancel();
+                    return;
+                }
+            }
+            replay.leave(replay.describe(r) + ", but there is no such event");
+            break;
+        case Trace::REPRODUCE: {
+            Puppet* child = nullptr;
+            auto i = made.find(r.b);
+            if (i != made.end()) child = static_cast<Puppet*>(&*i->second);
+            else child = find(r.b);
+            if (child == nullptr) return;
+            if (r.kind < replay.species_names.size()) child->name = replay.species_names[r.kind];
+            target->reproduce(child);
+            break;
+        }
+        default:
+            replay.leave(replay.describe(r) + " can't be played");
+            break;
+    }
+}
+
+
+Replay::Replay(const string& source)
+{
+    ifstream in(source, ios::binary);
+    if (!in) {
+        cerr << "Replay: cannot open " << source << "\n";
+        good = false;
+        return;
+    }
+    Packet p;
+    p.bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    if (p.get_string() != Trace::header) {
+        cerr << "Replay: " << source << ": not a trace\n";
+        good = false;
+        return;
+    }
+    world_seed = (unsigned long) p.get<uint64_t>();
+    for (uint32_t n = p.get<uint32_t>(); n > 0 && p.ok(); n -= 1) {
+        kind_names.push_back(p.get_string());
+        Event::Kind k = Event::find_kind(kind_names.back());
+        if (k) kinds[k] = (uint16_t) (kind_names.size() - 1);
+    }
+    for (uint32_t n = p.get<uint32_t>(); n > 0 && p.ok(); n -= 1) {
+        species_names.push_back(p.get_string());
+    }
+    while (p.ok() && !p.done()) {
+        records.push_back(p.get<Record>());
+    }
+    if (!p.ok()) {
+        cerr << "Replay: " << source << ": cut short\n";
+        good = false;
+        return;
+    }
+
+    for (uint32_t k = 0; k < records.size(); k += 1) {
+        const Record& r = records[k];
+        switch (r.what) {
+            case Trace::DISPATCH:
+                events.push_back(k);
+                break;
+            case Trace::CALL:
+                events.push_back(k);
+                scripts[r.who].at.push_back(k);
+                break;
+            case Trace::BIRTH:
+            case Trace::DEATH:
+            case Trace::EAT:
+                break;          // the simulator does those again
+            default:
+                scripts[r.who].at.push_back(k);
+                break;
+        }
+    }
+}
+
+void Replay::install(World& w)
+{
+    world = &w;
+    w.replay = this;
+    for (const string& name : species_names) {
+        if (name.empty()) continue;
+        LifeForm::add_creator([name](void) -> SmartPointer<LifeForm> { return new Puppet(name); },
+                              name);
+    }
+}
+
+void Replay::check(const Event& e)
+{
+    if (left) return;
+    if (next_event == events.size()) {
+        leave("the trace has no more events");
+        return;
+    }
+    const Record& r = records[events[next_event]];
+    next_event += 1;
+
+    Record got{};
+    got.time = world->now;
+    got.who = e.owner ? e.owner->handle : 0;
+    got.kind = 0xffff;
+    got.a = e.active;
+    if (e.kind == &Puppet::on_act) {
+        vector<Puppet::Pending>& pending = static_cast<Puppet*>(e.owner)->pending;
+        for (size_t k = 0; k < pending.size(); k += 1) {
+            if (pending[k].event == &e) {
+                got.kind = pending[k].kind;
+                pending.erase(pending.begin() + k);
+                break;
+            }
+        }
+        got.what = e.active ? Trace::CALL : Trace::DISPATCH;
+    }
+    else {
+        auto k = kinds.find(e.kind);
+        if (k != kinds.end()) got.kind = k->second;
+        got.what = Trace::DISPATCH;
+    }
+    if (got.time != r.time || got.who != r.who || got.kind != r.kind || got.what != r.what
+        || got.a != r.a) {
+        leave("the trace has " + describe(r) + ", the replay ran " + describe(got));
+    }
+}
+
+void Replay::leave(const string& why)
+{
+    if (left) return;
+    left = true;
+    cerr << "Replay: left the trace at time " << world->now << ": " << why << "\n";
+    world->stop();
+}
+
+bool Replay::summary(void) const
+{
+    if (left) return false;
+    if (next_event < events.size()) {
+        cerr << "Replay: the run ended at time " << world->now << ", " << events.size() - next_event
+             << " events before the trace did\n";
+        return false;
+    }
+    cerr << "Replay: " << events.size() << " events, " << records.size() << " records, as traced\n";
+    return true;
+}
+
+string Replay::describe(const Record& r) const
+{
+    ostringstream s;
+    s << (r.what < sizeof(what_names) / sizeof(what_names[0]) ? what_names[r.what] : "?");
+    if (r.what == Trace::DISPATCH || r.what == Trace::CALL) {
+        s << " " << (r.kind < kind_names.size() ? kind_names[r.kind] : string("(closure)"));
+        if (r.what == Trace::DISPATCH && !r.a) s << " (cancelled)";
+    }
+    s << " by " << r.who;
+    if (r.target) s << " to " << r.target;
+    s << " at " << r.time;
+    return s.str();
+}
@@ -0,0 +1,85 @@
+#if !(_Replay_h)
+#define _Replay_h 1
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Event.h"
+#include "Trace.h"
+
+class Puppet;
+class World;
+
+/*
+ * Class name: Replay
+ * Description:
+ *  Runs a simulation again from a Trace (see Trace.h), without running
+ *  any species code: every species is played by a Puppet, a LifeForm
+ *  that does (through the same protected interface, at the same moments)
+ *  what the trace says the real one did, and chooses what the trace says
+ *  it chose in its encounters.  Everything else (moving, aging,
+ *  encounters, eating, spores, the reports) is the simulator's own code,
+ *  run just as it was, so a replay is the original run, minus the cost
+ *  of the species (e.g., to profile the simulator alone), and a
+ *  simulator that has been changed can be replayed against an old trace
+ *  to see whether (and where) it behaves differently.
+ *
+ *  Every event that is run is checked against the trace (its time, its
+ *  owner, its kind, and whether it was cancelled).  At the first one
+ *  that differs, the replay says so and stops the World.
+ *
+ *  The World must be made with seed(), and the same program parameters
+ *  and config.test as the run that was traced.
+ *
+ *  Usage:
+ *      Replay r("run.trace");
+ *      World world(r.seed(), false);
+ *      r.install(world);               // before anything is simulated
+ *      ... simulate the world as the traced run did ...
+ *      r.summary();
+ */
+class Replay {
+public:
+    explicit Replay(const std::string& source);
+
+    bool ok(void) const { return good; }
+    unsigned long seed(void) const { return world_seed; }
+    void install(World&);       // play every species of the trace in this World
+    bool summary(void) const;   // print how it went, false if it left the trace
+
+    void check(const Event&);   // the hook, called by Event::do_next
+
+private:
+    typedef Trace::Record Record;
+
+    /* the Records that a LifeForm did, and how far it has got */
+    struct Script {
+        std::vector<uint32_t> at;
+        size_t next = 0;
+    };
+
+    bool good = true;
+    unsigned long world_seed = 1;
+    World* world = nullptr;
+    std::vector<Record> records;
+    std::vector<std::string> kind_names;    // by number in the trace
+    std::vector<std::string> species_names;
+    std::unordered_map<Event::Kind, uint16_t> kinds;    // local kinds, by number in the trace
+    std::vector<uint32_t> events;           // the DISPATCH and CALL Records
+    size_t next_event = 0;
+    std::unordered_map<uint64_t, Script> scripts;       // by handle
+    std::unordered_map<uint64_t, Puppet*> live;         // the Puppets, by handle
+    bool left = false;
+
+    void leave(const std::string& why);     // the run has left the trace
+    std::string describe(const Record&) const;
+
+    Replay(const Replay&) = delete;
+    void operator=(const Replay&) = delete;
+
+    friend class Puppet;
+};
+
+#endif /* !(_Replay_h) */
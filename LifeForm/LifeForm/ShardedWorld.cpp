@@ -0,0 +1,790 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ShardedWorld.h"
+#include "Event.h"
+#include "LifeForm.h"
+#include "ObjInfo.h"
+#include "Packet.h"
+#include "Params.h"
+
+using namespace std;
+
+/* an id is the number of the shard that gave it << id_bits, plus a count */
+static const unsigned id_bits = 40;
+
+/*
+ * one end of a Unix socket, that sends and receives whole Packets (each
+ * one after its length).  transfer sends and receives on several Links
+ * at once, so that two processes that send each other big messages at
+ * the same time don't both wait for the other to read
+ */
+class ShardedWorld::Link {
+public:
+    explicit Link(int fd) : fd(fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+    ~Link(void) { close(fd); }
+
+    const Packet* sending = nullptr;    // set these, then transfer
+    Packet* receiving = nullptr;
+
+    bool send(const Packet& p) { sending = &p; return transfer({ this }); }
+    bool receive(Packet& p) { receiving = &p; return transfer({ this }); }
+
+    /* false if a socket failed, or the other end is gone */
+    static bool transfer(const vector<Link*>&);
+
+private:
+    int fd;
+    vector<char> frame;                 // what is being sent, after its length
+    size_t sent = 0;
+    uint32_t length = 0;                // of what is being received
+    size_t received = 0;                // (including the length)
+
+    void start(void);
+    bool pump(short events);
+
+    Link(const Link&) = delete;
+    void operator=(const Link&) = delete;
+};
+
+void ShardedWorld::Link::start(void)
+{
+    if (sending) {
+        uint32_t n = (uint32_t) sending->bytes.size();
+        const char* p = reinterpret_cast<const char*>(&n);
+        frame.assign(p, p + sizeof n);
+        frame.insert(frame.end(), sending->bytes.begin(), sending->bytes.end());
+        sent = 0;
+    }
+    if (receiving) {
+        receiving->clear();
+        received = 0;
+    }
+}
+
+bool ShardedWorld::Link::pump(short events)
+{
+    if (sending && (events & (POLLOUT | POLLHUP))) {
+        ssize_t n = write(fd, frame.data() + sent, frame.size() - sent);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+        if (n > 0) sent += n;
+        if (sent == frame.size()) sending = nullptr;
+    }
+    if (receiving && (events & (POLLIN | POLLHUP))) {
+        char* to;
+        size_t want;
+        if (received < sizeof length) {
+            to = reinterpret_cast<char*>(&length) + received;
+            want = sizeof length - received;
+        }
+        else {
+            to = receiving->bytes.data() + (received - sizeof length);
+            want = sizeof length + length - received;
+        }
+        ssize_t n = read(fd, to, want);
+        if (n == 0) return false;       // the other end is gone
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+        if (n > 0) {
+            received += n;
+            if (received == sizeof length) receiving->bytes.resize(length);
+        }
+        if (received >= sizeof length && received == sizeof length + length) receiving = nullptr;
+    }
+    return true;
+}
+
+bool ShardedWorld::Link::transfer(const vector<Link*>& links)
+{
+    for (Link* l : links) l->start();
+    vector<pollfd> fds;
+    vector<Link*> busy;
+    for (;;) {
+        fds.clear();
+        busy.clear();
+        for (Link* l : links) {
+            short events = (l->sending ? POLLOUT : 0) | (l->receiving ? POLLIN : 0);
+            if (events == 0) continue;
+            fds.push_back(pollfd{ l->fd, events, 0 });
+            busy.push_back(l);
+        }
+        if (fds.empty()) return true;
+        if (poll(fds.data(), (nfds_t) fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (size_t i = 0; i < fds.size(); i += 1) {
+            if (fds[i].revents & (POLLERR | POLLNVAL)) return false;
+            if (!busy[i]->pump(fds[i].revents)) return false;
+        }
+    }
+}
+
+/* a LifeForm (of this shard) eats one of a neighbour's, whose ghost it ran into */
+struct Bite {
+    uint64_t victim, eater;
+};
+
+/* what the neighbour sends back, if the victim was still alive */
+struct Meal {
+    uint64_t eater;
+    double gain;
+};
+
+/*
+ * the shard on one side, and what is kept for it: what goes in the next
+ * message to it, and the ghosts of its LifeForms (by their ids, and in
+ * the order they were made, as in a TiledWorld)
+ */
+struct ShardedWorld::Neighbour {
+    unsigned shard;
+    unique_ptr<Link> link;
+
+    vector<Meal> meals;
+    vector<Bite> bites;
+    uint32_t num_ghosts = 0;
+    Packet ghosts;
+    uint32_t num_migrants = 0;
+    Packet migrants;
+    Packet out, in;
+
+    unordered_map<uint64_t, SmartPointer<LifeForm>> ghost_of;
+    vector<uint64_t> ghost_order;
+};
+
+/*
+ * the stand-in, in a shard, for a LifeForm of a neighbouring shard (see
+ * Ghost in TiledWorld.cpp, all a Remote knows of its LifeForm is the id)
+ */
+class Remote : public LifeForm {
+public:
+    Remote(uint64_t id, const string& name, Color color) : id(id), name(name), color(color) {}
+
+    uint64_t id;
+
+    Color my_color(void) const { return color; }
+    Action encounter(const ObjInfo&) { return LIFEFORM_IGNORE; }
+    string species_name(void) const { return name; }
+
+private:
+    bool is_ghost(void) const { return true; }
+
+    string name;
+    Color color;
+};
+
+static Remote& as_remote(const SmartPointer<LifeForm>& g) {
+    return static_cast<Remote&>(*g);
+}
+
+ShardedWorld::ShardedWorld(unsigned n, unsigned long seed)
+    : totals(seed, false), num_shards(std::max(n, 1u)), seed(seed),
+      side((double) grid_max / num_shards),
+      ghost_range(tile_sight + encounter_distance + 2.0 * max_speed * tile_lookahead)
+{
+}
+
+ShardedWorld::~ShardedWorld(void)
+{
+}
+
+unsigned ShardedWorld::stripe_at(const Point& p) const {
+    return (unsigned) std::min(std::max((int) (p.xpos / side), 0), (int) num_shards - 1);
+}
+
+/*
+ * each shard gets a socket to the coordinator, and each pair of
+ * neighbours a socket between them.  every process closes the ends that
+ * aren't its own, so that when a process goes away, the others notice
+ */
+bool ShardedWorld::simulate(double time_lapse, const function<void(void)>& populate,
+                            const function<void(void)>& tick)
+{
+    signal(SIGPIPE, SIG_IGN);           // a write to a process that is gone just fails
+
+    vector<int> up(2 * num_shards, -1);             // coordinator, shard k
+    vector<int> across(2 * (num_shards - 1), -1);   // shard k, shard k + 1
+    bool ok = true;
+    for (unsigned k = 0; ok && k < num_shards; k += 1) {
+        ok = socketpair(AF_UNIX, SOCK_STREAM, 0, &up[2 * k]) == 0;
+    }
+    for (unsigned k = 0; ok && k + 1 < num_shards; k += 1) {
+        ok = socketpair(AF_UNIX, SOCK_STREAM, 0, &across[2 * k]) == 0;
+    }
+    if (!ok) perror("socketpair");
+
+    /* (anything still buffered would be written by every process) */
+    cout.flush();
+    cerr.flush();
+    vector<pid_t> children;
+    for (unsigned k = 0; ok && k < num_shards; k += 1) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            ok = false;
+            break;
+        }
+        if (pid > 0) {
+            children.push_back(pid);
+            continue;
+        }
+
+        /* the shard */
+        int status = 0;
+        try {
+            me = k;
+            coordinator.reset(new Link(up[2 * k + 1]));
+            up[2 * k + 1] = -1;
+            if (k > 0) {
+                left.reset(new Neighbour);
+                left->shard = k - 1;
+                left->link.reset(new Link(across[2 * (k - 1) + 1]));
+                across[2 * (k - 1) + 1] = -1;
+            }
+            if (k + 1 < num_shards) {
+                right.reset(new Neighbour);
+                right->shard = k + 1;
+                right->link.reset(new Link(across[2 * k]));
+                across[2 * k] = -1;
+            }
+            for (int fd : up) if (fd >= 0) close(fd);
+            for (int fd : across) if (fd >= 0) close(fd);
+            run_shard(time_lapse, populate, tick);
+        }
+        catch (const exception& e) {
+            cerr << "shard " << k << ": " << e.what() << endl;
+            status = 1;
+        }
+        cout.flush();
+        _exit(status);
+    }
+
+    for (unsigned k = 0; k < num_shards; k += 1) {
+        if (up[2 * k] >= 0 && k < children.size()) shards.emplace_back(new Link(up[2 * k]));
+        else if (up[2 * k] >= 0) close(up[2 * k]);
+        if (up[2 * k + 1] >= 0) close(up[2 * k + 1]);
+    }
+    for (int fd : across) if (fd >= 0) close(fd);
+
+    if (ok) coordinate();
+    shards.clear();                     // a shard that is still waiting gives up
+
+    for (pid_t pid : children) {
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    if (!ok) cerr << "ShardedWorld: a shard failed\n";
+    return ok;
+}
+
+/* the coordinator: a report from every shard after every window */
+void ShardedWorld::coordinate(void)
+{
+    while (add_up()) {}
+}
+
+/*
+ * add up the reports of the shards into totals, report them (if the
+ * shards have just caught up), and tell the shards whether to go on
+ */
+bool ShardedWorld::add_up(void)
+{
+    totals.species_stats.assign(Species::count(), SpeciesStats());
+    uint32_t num_objects = 0;
+    unsigned num_events = 0;
+    bool caught_up = false;
+    bool ok = true;
+    num_moved = num_bytes = 0;
+
+    Packet in;
+    for (auto& shard : shards) {
+        if (!shard->receive(in)) {
+            ok = false;
+            break;
+        }
+        totals.now = in.get<double>();
+        caught_up = in.get<uint8_t>() != 0;
+        num_events += in.get<uint32_t>();
+        num_objects += in.get<uint32_t>();
+        num_moved += in.get<uint64_t>();
+        num_bytes += in.get<uint64_t>();
+        uint32_t num_species = in.get<uint32_t>();
+        for (uint32_t s = 0; s < num_species && in.ok(); s += 1) {
+            Species::Id k = Species::intern(in.get_string()).index();
+            SpeciesStats stats = in.get<SpeciesStats>();
+            if (k >= totals.species_stats.size()) totals.species_stats.resize(Species::count());
+            SpeciesStats& sum = totals.species_stats[k];
+            sum.alive += stats.alive;
+            sum.energy += stats.energy;
+            sum.births += stats.births;
+            sum.deaths += stats.deaths;
+            sum.eats += stats.eats;
+        }
+        if (!in.ok()) {
+            ok = false;
+            break;
+        }
+    }
+
+    if (ok && caught_up) {
+        LifeForm::report(totals, num_objects, num_events);
+        if (!totals.metrics) {
+            ostringstream out;
+            out << "Shards: " << num_shards << " processes, " << num_moved
+                << " LifeForms moved, " << num_bytes << " bytes exchanged\n";
+            cout << out.str();
+        }
+    }
+
+    bool go = ok && !totals.stopped() && num_events > 0;
+    Packet verdict;
+    verdict.put((uint8_t) go);
+    for (auto& shard : shards) {
+        shard->send(verdict);
+    }
+    return go;
+}
+
+/*
+ * a shard: the first LifeForms (and the ghosts of its neighbours' first
+ * LifeForms), then one window after another, until the coordinator says
+ * to stop.  the spores are made between windows, as in a TiledWorld
+ */
+void ShardedWorld::run_shard(double time_lapse, const function<void(void)>& populate,
+                             const function<void(void)>& tick)
+{
+    world.reset(new World((seed - 1) * num_shards + me + 1, false));
+    nursery.reset(new World(seed, false));
+    {
+        World::Scope in(*nursery);
+        populate();
+    }
+    adopt();
+    send_ghosts();
+    exchange();
+    report(true);
+    if (!verdict()) return;
+
+    SimTime last_time = 0.0;
+    SimTime next_tick = 1.0;
+    for (;;) {
+        SimTime window_end = world->now + tile_lookahead;
+        bool catch_up = window_end - last_time > time_lapse;
+        {
+            World::Scope in(*world);
+            Event::do_until(window_end);
+            if (catch_up) {
+                /* what redisplay_all does before it draws */
+                if (live_order != ANY_ORDER) LifeForm::sort_living(live_order);
+                LifeForm::advance_all();
+            }
+        }
+
+        resolve_border_encounters();
+        send_migrants();
+        send_ghosts();
+        exchange();
+
+        nursery->now = world->now;
+        while (tick && next_tick <= world->now) {
+            World::Scope in(*nursery);
+            tick();
+            next_tick += 1.0;
+        }
+        adopt();
+
+        if (catch_up) last_time = world->now;
+        report(catch_up);
+        if (!verdict()) return;
+    }
+}
+
+uint64_t ShardedWorld::id_of(LifeForm& lf)
+{
+    auto i = ids.find(&lf);
+    if (i != ids.end()) return i->second;
+    uint64_t id = ((uint64_t) me << id_bits) | next_id++;
+    ids[&lf] = id;
+    by_id[id] = SmartPointer<LifeForm>(&lf);
+    return id;
+}
+
+/*
+ * keep the LifeForms of the nursery that are in our stripe (with their
+ * events, and counted as births here), and throw the rest away.  every
+ * shard's nursery has made the same ones
+ */
+void ShardedWorld::adopt(void)
+{
+    vector<SmartPointer<LifeForm>> mine, others;
+    for (LifeForm* lf : nursery->all_life.living()) {
+        if (stripe_at(lf->position()) == me) mine.push_back(lf);
+        else others.push_back(lf);
+    }
+    if (mine.empty() && others.empty()) return;
+
+    unordered_set<const LifeForm*> moving;
+    for (auto& lf : mine) {
+        lf->move_to(*world);
+        if (&lf->home() == &*world) {
+            moving.insert(&*lf);
+            lf->stats().births += 1;
+        }
+    }
+    Event::move_owned(*nursery, moving);
+    for (auto& lf : mine) {
+        if (!lf->is_alive()) continue;
+        World::Scope in(*world);
+        lf->region_resize();
+    }
+
+    World::Scope in(*nursery);
+    for (auto& lf : others) {
+        lf->die();
+    }
+    nursery->equeue.clear();
+}
+
+/*
+ * the encounters with ghosts that were found in the window.  each
+ * LifeForm meets each ghost once, and decides on its own: the ghost
+ * ignores it.  a LifeForm that wants to eat and wins pays for eating
+ * now, and gets the meal when the neighbour sends it back
+ */
+void ShardedWorld::resolve_border_encounters(void)
+{
+    World::Scope in(*world);
+    set<pair<LifeForm*, uint64_t>> done;
+    for (auto& e : world->border_encounters) {
+        SmartPointer<LifeForm> me = e.first;
+        LifeForm& other = *e.second;
+        uint64_t victim = as_remote(e.second).id;
+        if (!me->is_alive()) continue;
+        if (!done.insert(make_pair(&*me, victim)).second) continue;
+
+        me->add_energy(-encounter_penalty);
+        if (me->energy() < min_energy) {
+            me->die();
+            continue;
+        }
+        if (me->encounter(me->info_about_them(e.second)) != LIFEFORM_EAT) continue;
+        if (me->drand48() >= eat_success_chance(me->energy(), other.energy())) continue;
+        me->add_energy(-eat_cost_function());
+        if (me->energy() < min_energy) {
+            me->die();
+            continue;
+        }
+        Neighbour& n = (victim >> id_bits) < this->me ? *left : *right;
+        n.bites.push_back(Bite{ victim, id_of(*me) });
+    }
+    world->border_encounters.clear();
+}
+
+/*
+ * the LifeForms that have wandered out of our stripe go to the
+ * neighbour on that side (which sends them on, if they have gone
+ * farther).  what is left of them here departs, and their events are
+ * thrown away
+ */
+void ShardedWorld::send_migrants(void)
+{
+    World::Scope in(*world);
+    vector<SmartPointer<LifeForm>> leaving;
+    for (LifeForm* lf : world->all_life.living()) {
+        if (stripe_at(lf->position()) != me) leaving.push_back(lf);
+    }
+    if (leaving.empty()) return;
+
+    unordered_set<const LifeForm*> gone;
+    vector<Event**> members;
+    for (auto& lf : leaving) {
+        if (!lf->is_alive()) continue;  // (departing resizes the regions of others)
+        Neighbour& n = stripe_at(lf->position()) < me ? *left : *right;
+        const LifeFormState& rows = world->all_life;
+        uint32_t k = lf->vector_pos;
+        Packet& out = n.migrants;
+        out.put_string(lf->species().name());
+        out.put_point(rows.pos[k]);
+        out.put(rows.speed[k]);
+        out.put(rows.course[k]);
+        out.put(rows.update_time[k]);
+        out.put(rows.energy[k]);
+        out.put(rows.dir_x[k]);
+        out.put(rows.dir_y[k]);
+        out.put(rows.move_cost[k]);
+        out.put(lf->reproduce_time);
+        out.put(lf->random);
+        n.num_migrants += 1;
+        moved += 1;
+
+        lf->depart();
+        gone.insert(&*lf);
+        members.clear();
+        lf->event_members(members);
+        for (Event** e : members) *e = nullptr;
+    }
+    Event::drop_owned(*world, gone);
+}
+
+/* our LifeForms that are near a neighbour's stripe */
+void ShardedWorld::send_ghosts(void)
+{
+    double left_edge = me * side;
+    double right_edge = (me + 1) * side;
+    for (LifeForm* lf : world->all_life.living()) {
+        const Point& p = lf->position();
+        Neighbour* to[2] = { nullptr, nullptr };
+        if (left && p.xpos < left_edge + ghost_range) to[0] = &*left;
+        if (right && p.xpos >= right_edge - ghost_range) to[1] = &*right;
+        for (Neighbour* n : to) {
+            if (!n) continue;
+            Packet& out = n->ghosts;
+            out.put(id_of(*lf));
+            out.put_string(lf->species().name());
+            out.put((int32_t) lf->my_color());
+            out.put_point(p);
+            out.put(lf->speed());
+            out.put(lf->course());
+            out.put(lf->energy());
+            n->num_ghosts += 1;
+        }
+    }
+}
+
+/*
+ * one message each way between us and each neighbour, then what came
+ * in: the meals first (they are for bites we sent in the last message),
+ * then the bites, the ghosts (so that the ghost of a LifeForm that has
+ * just moved here is gone before it arrives) and the migrants
+ */
+void ShardedWorld::exchange(void)
+{
+    vector<Link*> links;
+    for (Neighbour* n : { left.get(), right.get() }) {
+        if (!n) continue;
+        Packet& out = n->out;
+        out.clear();
+        out.put((uint32_t) n->meals.size());
+        for (const Meal& m : n->meals) out.put(m);
+        out.put((uint32_t) n->bites.size());
+        for (const Bite& b : n->bites) out.put(b);
+        out.put(n->num_ghosts);
+        out.bytes.insert(out.bytes.end(), n->ghosts.bytes.begin(), n->ghosts.bytes.end());
+        out.put(n->num_migrants);
+        out.bytes.insert(out.bytes.end(), n->migrants.bytes.begin(), n->migrants.bytes.end());
+        n->meals.clear();
+        n->bites.clear();
+        n->migrants.clear();
+        n->num_migrants = 0;
+        n->ghosts.clear();
+        n->num_ghosts = 0;
+        bytes += out.bytes.size();
+
+        n->link->sending = &out;
+        n->link->receiving = &n->in;
+        links.push_back(&*n->link);
+    }
+    if (!Link::transfer(links)) throw runtime_error("lost a neighbour");
+
+    World::Scope in(*world);
+    for (Neighbour* n : { left.get(), right.get() }) {
+        if (!n) continue;
+        take_meals(n->in);
+        take_bites(*n, n->in);
+        take_ghosts(*n, n->in);
+        take_migrants(n->in);
+        if (!n->in.ok()) throw runtime_error("a bad message from a neighbour");
+    }
+    forget_departed();
+}
+
+void ShardedWorld::take_meals(Packet& in)
+{
+    uint32_t num_meals = in.get<uint32_t>();
+    for (uint32_t k = 0; k < num_meals && in.ok(); k += 1) {
+        Meal m = in.get<Meal>();
+        auto i = by_id.find(m.eater);
+        if (i == by_id.end() || !i->second->is_alive()) continue;
+        LifeForm* p = &*i->second;
+        new Event(digestion_time, &LifeForm::on_digest, p, m.gain);
+        p->stats().eats += 1;
+    }
+}
+
+void ShardedWorld::take_bites(Neighbour& n, Packet& in)
+{
+    uint32_t num_bites = in.get<uint32_t>();
+    for (uint32_t k = 0; k < num_bites && in.ok(); k += 1) {
+        Bite b = in.get<Bite>();
+        auto i = by_id.find(b.victim);
+        if (i == by_id.end() || !i->second->is_alive()) continue;
+        LifeForm& victim = *i->second;
+        n.meals.push_back(Meal{ b.eater, victim.energy() * eat_efficiency });
+        victim.die();
+    }
+}
+
+/*
+ * make our ghosts of the neighbour's LifeForms match the ones it has
+ * just sent (see TiledWorld::refresh_ghosts)
+ */
+void ShardedWorld::take_ghosts(Neighbour& n, Packet& in)
+{
+    struct Seen {
+        uint64_t id;
+        string name;
+        Color color;
+        Point pos;
+        double speed, course, energy;
+    };
+    vector<Seen> wanted(in.get<uint32_t>());
+    for (Seen& s : wanted) {
+        s.id = in.get<uint64_t>();
+        s.name = in.get_string();
+        s.color = (Color) in.get<int32_t>();
+        s.pos = in.get_point();
+        s.speed = in.get<double>();
+        s.course = in.get<double>();
+        s.energy = in.get<double>();
+        if (!in.ok()) return;
+    }
+
+    unordered_set<uint64_t> keep;
+    for (const Seen& s : wanted) keep.insert(s.id);
+    vector<uint64_t> order;
+    for (uint64_t id : n.ghost_order) {
+        auto g = n.ghost_of.find(id);
+        if (keep.count(id)) {
+            order.push_back(id);
+            continue;
+        }
+        world->space.remove(g->second->pos());
+        n.ghost_of.erase(g);
+    }
+
+    for (const Seen& s : wanted) {
+        auto g = n.ghost_of.find(s.id);
+        if (g == n.ghost_of.end()) {
+            if (world->space.is_occupied(s.pos)) continue;
+            SmartPointer<LifeForm> ghost = new Remote(s.id, s.name, s.color);
+            ghost->pos() = s.pos;
+            world->space.insert(ghost, ghost->pos());
+            g = n.ghost_of.insert(make_pair(s.id, ghost)).first;
+            order.push_back(s.id);
+        }
+        else if (g->second->pos() != s.pos && !world->space.is_occupied(s.pos)) {
+            world->space.update_position(g->second->pos(), s.pos);
+            g->second->pos() = s.pos;
+        }
+        LifeForm& ghost = *g->second;
+        ghost.speed() = s.speed;
+        ghost.course() = s.course;
+        ghost.all_life->energy[ghost.vector_pos] = s.energy;
+    }
+    n.ghost_order.swap(order);
+}
+
+/*
+ * remake each LifeForm that has come from the neighbour with its species'
+ * creator, and give it the row it had there
+ */
+void ShardedWorld::take_migrants(Packet& in)
+{
+    uint32_t num_migrants = in.get<uint32_t>();
+    for (uint32_t m = 0; m < num_migrants && in.ok(); m += 1) {
+        string name = in.get_string();
+        Point pos = in.get_point();
+        double speed = in.get<double>();
+        double course = in.get<double>();
+        double update_time = in.get<double>();
+        double energy = in.get<double>();
+        double dir_x = in.get<double>();
+        double dir_y = in.get<double>();
+        double move_cost = in.get<double>();
+        double reproduce_time = in.get<double>();
+        RandomStream random = in.get<RandomStream>();
+        auto make = LifeForm::istream_creators().find(name);
+        if (!in.ok() || make == LifeForm::istream_creators().end()) continue;
+
+        SmartPointer<LifeForm> lf = make->second();
+        LifeFormState& rows = world->all_life;
+        uint32_t k = lf->vector_pos;
+        rows.pos[k] = pos;
+        rows.speed[k] = speed;
+        rows.course[k] = course;
+        rows.update_time[k] = update_time;
+        rows.energy[k] = energy;
+        rows.dir_x[k] = dir_x;
+        rows.dir_y[k] = dir_y;
+        rows.move_cost[k] = move_cost;
+        lf->reproduce_time = reproduce_time;
+        lf->random = random;
+        lf->start_point = pos;
+
+        lf->arrive();
+        world->space.insert(lf, lf->pos(), [lf](void) { lf->region_resize(); });
+        new Event(age_frequency, &LifeForm::on_age, &*lf);
+        lf->compute_next_move();
+    }
+}
+
+/* the ids of LifeForms that have died or left can't be bitten any more */
+void ShardedWorld::forget_departed(void)
+{
+    for (auto i = by_id.begin(); i != by_id.end(); ) {
+        if (i->second->is_alive()) {
+            ++i;
+            continue;
+        }
+        ids.erase(&*i->second);
+        i = by_id.erase(i);
+    }
+}
+
+void ShardedWorld::report(bool caught_up)
+{
+    uint32_t num_ghosts = 0;
+    for (Neighbour* n : { left.get(), right.get() }) {
+        if (n) num_ghosts += (uint32_t) n->ghost_of.size();
+    }
+
+    Packet out;
+    out.put(world->now);
+    out.put((uint8_t) caught_up);
+    out.put((uint32_t) world->equeue.size());
+    out.put(world->all_life.size() - num_ghosts);
+    out.put((uint64_t) moved);
+    out.put((uint64_t) bytes);
+    /* (a species may have died out here, and only have deaths) */
+    vector<Species::Id> seen;
+    for (Species::Id k = 1; k < world->species_stats.size(); k += 1) {
+        const SpeciesStats& s = world->species_stats[k];
+        if (s.alive || s.births || s.deaths || s.eats) seen.push_back(k);
+    }
+    out.put((uint32_t) seen.size());
+    for (Species::Id k : seen) {
+        out.put_string(Species::at(k).name());
+        out.put(world->species_stats[k]);
+    }
+    if (!coordinator->send(out)) throw runtime_error("lost the coordinator");
+}
+
+bool ShardedWorld::verdict(void)
+{
+    Packet in;
+    if (!coordinator->receive(in)) return false;
+    return in.get<uint8_t>() != 0;
+}
@@ -0,0 +1,122 @@
+#if !(_ShardedWorld_h)
+#define _ShardedWorld_h 1
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "World.h"
+
+class Packet;
+
+/*
+ * Class name: ShardedWorld
+ * Description:
+ *  One simulation, spread over several processes.  The grid is cut into
+ *  stripes (from left to right), and each stripe is simulated by a
+ *  process of its own (a shard), in a World of its own.  The process that
+ *  makes the ShardedWorld is the coordinator: it forks the shards, adds
+ *  up their species totals, reports, and decides when to stop.  The
+ *  shards only talk to their neighbours (the stripes on either side),
+ *  and to the coordinator, over Unix sockets.
+ *
+ *  The shards run in windows of tile_lookahead time units, as the tiles
+ *  of a TiledWorld do, and between windows each shard sends each of its
+ *  neighbours, in one message:
+ *    - the LifeForms that have wandered into the neighbour's stripe.  A
+ *      LifeForm can't be sent (its events are closures), so it is remade
+ *      there by its species' creator, with its row (position, motion,
+ *      energy, ...) and its RandomStream, and starts its events again: the ones its
+ *      constructor makes, aging, and crossing borders.  A Craig keeps its
+ *      course and speed; meals that were still being digested are lost
+ *    - ghosts of its LifeForms that are near the neighbour's stripe (see
+ *      tile_sight), which the neighbour puts in its QuadTree, just as a
+ *      tile of a TiledWorld does
+ *    - the encounters of its LifeForms with the neighbour's ghosts.  The
+ *      LifeForm that ran into the ghost decides (as though the other one
+ *      ignored it), and if it eats, the neighbour kills the real LifeForm
+ *      (if nothing has killed it first) and sends its energy back as a
+ *      meal, with the next message.  The other one decides when it runs
+ *      into a ghost of the first
+ *  and then sends the coordinator its species totals.  Spores (tick) and
+ *  the first LifeForms (populate) are made by every shard in a nursery
+ *  World that has the same seed in every shard, so every shard makes the
+ *  same ones, and each keeps the ones in its own stripe.
+ *
+ *  Like a TiledWorld, this is not the serial simulation: the results
+ *  are statistically the same (and the same every time).
+ *
+ *  The shards are processes on one machine (fork and socketpair), but
+ *  they share nothing except the sockets.
+ *
+ *  Usage:
+ *      ShardedWorld shards(4, seed);   // 4 processes
+ *      shards.simulate(time_lapse, [](void) { LifeForm::populate(); }, tick);
+ */
+class ShardedWorld {
+public:
+    ShardedWorld(unsigned num_shards, unsigned long seed = 1);
+    ~ShardedWorld(void);
+
+    /*
+     * as TiledWorld::simulate.  Only the coordinator returns, when the
+     * simulation is over: false if a shard couldn't be started or failed
+     */
+    bool simulate(double time_lapse, const std::function<void(void)>& populate,
+                  const std::function<void(void)>& tick);
+
+    World totals;               // reports for all of the shards (nothing runs in it)
+
+private:
+    class Link;
+    struct Neighbour;
+
+    unsigned num_shards;
+    unsigned long seed;
+    double side;                // the width of a stripe
+    double ghost_range;         // how far outside a stripe its ghosts are kept
+
+    /* the coordinator's ends of the sockets to the shards */
+    std::vector<std::unique_ptr<Link>> shards;
+    unsigned long num_moved = 0;
+    unsigned long num_bytes = 0;
+
+    void coordinate(void);
+    bool add_up(void);          // false if the simulation should stop
+
+    /* in a shard */
+    unsigned me = 0;            // the number of the shard
+    std::unique_ptr<World> world;
+    std::unique_ptr<World> nursery;
+    std::unique_ptr<Link> coordinator;
+    std::unique_ptr<Neighbour> left, right;
+    std::unordered_map<uint64_t, SmartPointer<LifeForm>> by_id;
+    std::unordered_map<const LifeForm*, uint64_t> ids;
+    uint64_t next_id = 0;
+    unsigned long moved = 0;    // LifeForms sent to neighbours
+    unsigned long bytes = 0;    // sent to neighbours
+
+    unsigned stripe_at(const Point&) const;
+    void run_shard(double time_lapse, const std::function<void(void)>& populate,
+                   const std::function<void(void)>& tick);
+    uint64_t id_of(LifeForm&);
+    void adopt(void);
+    void resolve_border_encounters(void);
+    void send_migrants(void);
+    void send_ghosts(void);
+    void exchange(void);
+    void take_meals(Packet&);
+    void take_bites(Neighbour&, Packet&);
+    void take_ghosts(Neighbour&, Packet&);
+    void take_migrants(Packet&);
+    void forget_departed(void);
+    void report(bool caught_up);
+    bool verdict(void);
+
+    ShardedWorld(const ShardedWorld&) = delete;
+    void operator=(const ShardedWorld&) = delete;
+};
+
+#endif /* !(_ShardedWorld_h) */
@@ -0,0 +1,238 @@
+#if !(_SlabPool_h)
+#define _SlabPool_h 1
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Class name: SlabPoolBase
+ * Description:
+ *  The part of a SlabPool that does not depend on the type of object,
+ *  so that the pools for every type can be listed together (all())
+ *  when the usage statistics are reported.
+ */
+class SlabPoolBase {
+public:
+    const std::string& name(void) const { return pool_name; }
+    size_t live(void) const { return num_live; }    // objects allocated right now
+    size_t peak(void) const { return num_peak; }    // the most ever allocated at once
+    size_t slabs(void) const { return num_slabs; }  // slabs obtained from the system
+
+    /*
+     * every pool that has been created.  the same trick as
+     * LifeForm::istream_creators, so the list exists before the
+     * first pool adds itself
+     */
+    static std::vector<SlabPoolBase*>& all(void) {
+        static std::vector<SlabPoolBase*> the_real_list;
+        return the_real_list;
+    }
+
+protected:
+    SlabPoolBase(const std::string& n) : pool_name(n) { all().push_back(this); }
+    ~SlabPoolBase(void) {}
+
+    /* changed by every thread that uses the pool, and read by anyone
+       (e.g., for the report of another World), so they are atomic */
+    std::string pool_name;
+    std::atomic<size_t> num_live{ 0 };
+    std::atomic<size_t> num_peak{ 0 };
+    std::atomic<size_t> num_slabs{ 0 };
+};
+
+/*
+ * Class name: SlabPool
+ * Description:
+ *  Memory for objects of exactly one type T.  Slabs of slab_size slots
+ *  are obtained from the system as needed and never given back; a slot is
+ *  handed out by popping the free list (the slots of objects that have
+ *  been deleted) or, when that is empty, by bumping through the newest
+ *  slab.  Both allocate and release are O(1).
+ *
+ *  The LifeForms of several Worlds (on several threads) share the pool,
+ *  so each thread has its own free list and slab to bump through, and
+ *  allocates and releases without a lock.  Only when a thread's free
+ *  list runs dry does it take a batch of slots from the pool's shared
+ *  list (or a slab of its own), and when it holds too many (e.g., a tile
+ *  that deletes the LifeForms that came from another one) it gives a
+ *  batch back; a thread that ends gives back all it has.  The counters
+ *  are the only thing that every allocate and release share.
+ *
+ *  A class uses a pool by defining its own operator new and (sized)
+ *  operator delete, e.g. for Craig (see Craig.h and Craig.cpp):
+ *
+ *      void* Craig::operator new(size_t bytes) {
+ *          return SlabPool<Craig>::the_pool("Craig").allocate(bytes);
+ *      }
+ *      void Craig::operator delete(void* p, size_t bytes) {
+ *          SlabPool<Craig>::the_pool("Craig").release(p, bytes);
+ *      }
+ *
+ *  Since LifeForm has a virtual destructor, SmartPointer's delete reaches
+ *  the operator delete of the actual type of the object, with its size.
+ *  A request for any other size (e.g., for a class derived from T that has
+ *  more data members) is passed on to the global operator new and delete.
+ */
+template <class T>
+class SlabPool : public SlabPoolBase {
+public:
+    static const size_t slab_size = 256;    // objects per slab
+
+    void* allocate(size_t bytes) {
+        if (bytes != sizeof(T)) { return ::operator new(bytes); }
+        Cache& c = mine();
+        if (c.finished) {
+            std::lock_guard<std::mutex> guard(lock);
+            counted(1);
+            if (shared_list) return take_one();
+            return ::operator new(sizeof(Slot));    // (only while the thread exits)
+        }
+        if (c.free_list == nullptr && c.bump == slab_size && !refill(c)) {
+            c.current = static_cast<Slot*>(::operator new(slab_size * sizeof(Slot)));
+            c.bump = 0;
+            num_slabs += 1;
+        }
+        Slot* s = c.free_list;
+        if (s) {
+            c.free_list = s->next;
+            c.num_free -= 1;
+        }
+        else {
+            s = &c.current[c.bump];
+            c.bump += 1;
+        }
+        counted(1);
+        return s;
+    }
+
+    void release(void* p, size_t bytes) {
+        if (p == nullptr) { return; }
+        if (bytes != sizeof(T)) { ::operator delete(p); return; }
+        Slot* s = static_cast<Slot*>(p);
+        Cache& c = mine();
+        if (c.finished) {
+            std::lock_guard<std::mutex> guard(lock);
+            s->next = shared_list;
+            shared_list = s;
+            shared_free += 1;
+        }
+        else {
+            s->next = c.free_list;
+            c.free_list = s;
+            c.num_free += 1;
+            if (c.num_free >= 2 * slab_size) give_back(c, slab_size);
+        }
+        counted(-1);
+    }
+
+    /*
+     * the one pool for T.  it is created on first use and never
+     * destroyed, so objects that are deleted while the program exits
+     * (e.g., by the destructors of other static objects) can still be
+     * given back to it
+     */
+    static SlabPool<T>& the_pool(const char* name) {
+        static SlabPool<T>* the_real_pool = new SlabPool<T>(name);
+        return *the_real_pool;
+    }
+
+private:
+    SlabPool(const std::string& n) : SlabPoolBase(n) {}
+
+    union Slot {
+        Slot* next;                         // while the slot is on a free list
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    /* a thread's own part of the pool.  it has no constructor or
+       destructor, so it is still there for the objects that are deleted
+       while the thread exits, after its Flusher has given it all back
+       (finished) */
+    struct Cache {
+        Slot* free_list;
+        size_t num_free;
+        Slot* current;                      // the slab that is being bumped through
+        size_t bump;                        // the next unused slot of current
+        bool started;
+        bool finished;                      // from now on, use the shared list
+    };
+    struct Flusher {
+        SlabPool<T>* pool = nullptr;
+        ~Flusher(void) {
+            Cache& c = cache;
+            pool->give_back(c, c.num_free);
+            std::lock_guard<std::mutex> guard(pool->lock);
+            for (; c.bump < slab_size; c.bump++) {
+                c.current[c.bump].next = pool->shared_list;
+                pool->shared_list = &c.current[c.bump];
+                pool->shared_free += 1;
+            }
+            c.finished = true;
+        }
+    };
+    static thread_local Cache cache;
+
+    Cache& mine(void) {
+        if (!cache.started) {
+            cache.started = true;
+            cache.bump = slab_size;
+            static thread_local Flusher flusher;
+            flusher.pool = this;
+        }
+        return cache;
+    }
+
+    void counted(int change) {
+        if (change < 0) { num_live -= 1; return; }
+        size_t now = num_live += 1;
+        size_t peak = num_peak.load();
+        while (now > peak && !num_peak.compare_exchange_weak(peak, now)) {}
+    }
+
+    /* move up to a slab's worth of slots from the shared list to c's; false if it is empty */
+    bool refill(Cache& c) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (shared_list == nullptr) return false;
+        for (size_t k = 0; k < slab_size && shared_list; k++) take_one(c);
+        return true;
+    }
+    void take_one(Cache& c) {
+        Slot* s = take_one();
+        s->next = c.free_list;
+        c.free_list = s;
+        c.num_free += 1;
+    }
+    Slot* take_one(void) {                  // (under lock)
+        Slot* s = shared_list;
+        shared_list = s->next;
+        shared_free -= 1;
+        return s;
+    }
+
+    /* move n slots from c's free list to the shared list */
+    void give_back(Cache& c, size_t n) {
+        if (n == 0) return;
+        Slot* first = c.free_list;
+        Slot* last = first;
+        for (size_t k = 1; k < n; k++) last = last->next;
+        c.free_list = last->next;
+        c.num_free -= n;
+        std::lock_guard<std::mutex> guard(lock);
+        last->next = shared_list;
+        shared_list = first;
+        shared_free += n;
+    }
+
+    std::mutex lock;                        // for the shared list
+    Slot* shared_list = nullptr;
+    size_t shared_free = 0;
+};
+
+template <class T>
+thread_local typename SlabPool<T>::Cache SlabPool<T>::cache;
+
+#endif /* !(_SlabPool_h) */
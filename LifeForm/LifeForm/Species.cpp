@@ -0,0 +1,65 @@
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Species.h"
+
+using namespace std;
+
+/*
+ * the registry is kept in static locals (the same trick as
+ * LifeForm::istream_creators) so that it exists before any static
+ * initializer calls add_creator.
+ * names is a deque so that references to the names stay valid as
+ * more species are interned.
+ * Several Worlds may intern names at once, so intern holds lock().
+ * Names never change once they are interned, so they are published in
+ * table (a pointer to each one, by Id) and num_names, which need no
+ * initialization at run time, and count() and name() read them without
+ * the lock.
+ */
+static mutex& lock(void) {
+    static mutex the_real_lock;
+    return the_real_lock;
+}
+
+static deque<string>& names(void) {
+    static deque<string> the_real_names;
+    return the_real_names;
+}
+
+static map<string, Species::Id>& ids(void) {
+    static map<string, Species::Id> the_real_ids;
+    return the_real_ids;
+}
+
+static const size_t capacity = 0xffff;      // (so that count() fits in an Id)
+static const string* table[capacity];       // table[0] ("no species") stays null
+static atomic<size_t> num_names{ 1 };
+
+Species Species::intern(const string& name) {
+    lock_guard<mutex> guard(lock());
+    auto i = ids().find(name);
+    if (i != ids().end()) { return Species(i->second); }
+
+    size_t n = num_names.load(memory_order_relaxed);
+    assert(n < capacity);
+    Id id = (Id) n;
+    names().push_back(name);
+    table[id] = &names().back();
+    ids()[name] = id;
+    num_names.store(n + 1, memory_order_release);
+    return Species(id);
+}
+
+Species::Id Species::count(void) {
+    return (Id) num_names.load(memory_order_acquire);
+}
+
+const string& Species::name(void) const {
+    static const string none;
+    return id == 0 ? none : *table[id];
+}
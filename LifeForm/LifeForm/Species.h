@@ -0,0 +1,64 @@
+#if !(_Species_h)
+#define _Species_h 1
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Class name: Species
+ * Description:
+ *  A Species is a small integer that stands for the name of a species
+ *  of LifeForm.  Every name is interned exactly once (LifeForm::add_creator
+ *  does it for every registered species), and from then on comparing two
+ *  Species is comparing two integers, and asking a Species for its name
+ *  returns a reference to the one interned copy of the string.
+ *
+ *  A Species is trivially copyable, so structs that carry one (e.g.,
+ *  ObjInfo) can be copied around without allocating anything.
+ *
+ *  The comparisons with strings are provided so that code written as
+ *      if (info.species == "Algae") ...
+ *  keeps working, but comparing against an interned Species is cheaper:
+ *      static const Species algae = Species::intern("Algae");
+ *      if (info.species == algae) ...
+ */
+class Species {
+public:
+    typedef uint16_t Id;
+
+    Species(void) : id(0) {}    // "no species"
+
+    static Species intern(const std::string&); // find (or create) the Species with this name
+    static Id count(void);      // the number of Species interned so far (including "no species")
+    static Species at(Id i) { return Species(i); } // the Species whose index() is i (i < count())
+
+    Id index(void) const { return id; }
+    const std::string& name(void) const;
+    operator const std::string&(void) const { return name(); }
+
+    bool operator==(Species s) const { return id == s.id; }
+    bool operator!=(Species s) const { return id != s.id; }
+    bool operator==(const std::string& s) const { return name() == s; }
+    bool operator!=(const std::string& s) const { return name() != s; }
+    bool operator==(const char* s) const { return name() == s; }
+    bool operator!=(const char* s) const { return name() != s; }
+
+private:
+    explicit Species(Id i) : id(i) {}
+    Id id;
+};
+
+/*
+ * the running totals for one Species, kept up to date by LifeForm as its
+ * members are born, eat, gain or spend energy, and die
+ * (see World::species_stats)
+ */
+struct SpeciesStats {
+    uint32_t alive = 0;         // the number of members alive right now
+    double energy = 0.0;        // the total energy of those members
+    unsigned long births = 0;   // members that have entered the simulation
+    unsigned long deaths = 0;
+    unsigned long eats = 0;     // meals eaten by members
+};
+
+#endif /* !(_Species_h) */
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_set>
+
+#include "TiledWorld.h"
+#include "Event.h"
+#include "LifeForm.h"
+#include "ObjInfo.h"
+#include "Params.h"
+
+using namespace std;
+
+/*
+ * the stand-in for a LifeForm of another tile.  a ghost is never alive
+ * (so it never moves, ages or eats, and it isn't counted or drawn), but
+ * it is in the tile's QuadTree, so it can be perceived, and a LifeForm
+ * that runs into it leaves a note in World::border_encounters.
+ * TiledWorld fills in its row (position, energy, ...) at every barrier
+ */
+class Ghost : public LifeForm {
+public:
+    Ghost(const SmartPointer<LifeForm>& of)
+        : of(of), name(of->species_name()), color(of->my_color()) {}
+
+    SmartPointer<LifeForm> of;          // the LifeForm, in its own tile
+
+    Color my_color(void) const { return color; }
+    Action encounter(const ObjInfo&) { return LIFEFORM_IGNORE; }
+    string species_name(void) const { return name; }
+
+private:
+    bool is_ghost(void) const { return true; }
+
+    string name;
+    Color color;
+};
+
+static Ghost& as_ghost(const SmartPointer<LifeForm>& g) {
+    return static_cast<Ghost&>(*g);
+}
+
+/*
+ * the tiles are numbered row by row.  each tile has its own seed, so
+ * the tiles of one TiledWorld don't make the same random choices
+ */
+TiledWorld::TiledWorld(unsigned n, unsigned long seed, double window)
+    : totals(seed, false), across(std::max(n, 1u)), side((double) grid_max / across),
+      window(window), ghost_range(tile_sight + encounter_distance + 2.0 * max_speed * window)
+{
+    unsigned num_tiles = across * across;
+    tiles.resize(num_tiles);
+    for (unsigned k = 0; k < num_tiles; k += 1) {
+        Tile& t = tiles[k];
+        t.world.reset(new World((seed - 1) * num_tiles + k + 1, false));
+        t.left = (k % across) * side;
+        t.right = t.left + side;
+        t.bottom = (k / across) * side;
+        t.top = t.bottom + side;
+    }
+    for (unsigned k = 0; k < num_tiles; k += 1) {
+        workers.emplace_back([this, k](void) { work(k); });
+    }
+}
+
+/*
+ * the ghosts hold on to LifeForms of other tiles, so they must all be
+ * gone before the first tile is destroyed
+ */
+TiledWorld::~TiledWorld(void)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        quitting = true;
+        changed.notify_all();
+    }
+    for (thread& w : workers) {
+        w.join();
+    }
+    for (Tile& t : tiles) {
+        t.world->border_encounters.clear();
+        while (!t.ghosts.empty()) {
+            drop_ghost(t, t.ghosts.begin()->first);
+        }
+    }
+}
+
+unsigned TiledWorld::tile_at(const Point& p) const {
+    int i = std::min(std::max((int) (p.xpos / side), 0), (int) across - 1);
+    int j = std::min(std::max((int) (p.ypos / side), 0), (int) across - 1);
+    return j * across + i;
+}
+
+bool TiledWorld::near_tile(const Point& p, const Tile& t) const {
+    double dx = std::max(std::max(t.left - p.xpos, p.xpos - t.right), 0.0);
+    double dy = std::max(std::max(t.bottom - p.ypos, p.ypos - t.top), 0.0);
+    return dx <= ghost_range && dy <= ghost_range;
+}
+
+void TiledWorld::simulate(double time_lapse, const function<void(void)>& populate,
+                          const function<void(void)>& tick)
+{
+    {
+        World::Scope in(*tiles[0].world);
+        populate();
+    }
+    migrate();
+    refresh_ghosts();
+    add_up();
+
+    SimTime last_time = 0.0;
+    SimTime next_tick = 1.0;
+    unsigned num_events = 0;
+    for (Tile& t : tiles) num_events += t.world->equeue.size();
+
+    while (!totals.stopped() && num_events > 0) {
+        window_end = totals.now + window;
+        catch_up = window_end - last_time > time_lapse;
+        run_window();
+        totals.now = window_end;
+
+        resolve_border_encounters();
+        while (tick && next_tick <= totals.now) {
+            World::Scope in(*tiles[0].world);
+            tick();
+            next_tick += 1.0;
+        }
+        migrate();
+        refresh_ghosts();
+
+        num_events = 0;
+        for (Tile& t : tiles) num_events += t.world->equeue.size();
+        if (catch_up) {
+            last_time = totals.now;
+            add_up();
+        }
+    }
+}
+
+/* start every tile on the window, and wait for all of them to finish it */
+void TiledWorld::run_window(void)
+{
+    unique_lock<mutex> guard(lock);
+    busy = (unsigned) tiles.size();
+    generation += 1;
+    changed.notify_all();
+    changed.wait(guard, [this](void) { return busy == 0; });
+}
+
+void TiledWorld::work(unsigned k)
+{
+    World::Scope in(*tiles[k].world);
+    unsigned long seen = 0;
+    unique_lock<mutex> guard(lock);
+    for (;;) {
+        changed.wait(guard, [this, &seen](void) { return quitting || generation != seen; });
+        if (quitting) return;
+        seen = generation;
+        guard.unlock();
+
+        run_tile(k);
+
+        guard.lock();
+        busy -= 1;
+        if (busy == 0) changed.notify_all();
+    }
+}
+
+/* the tiles only read window_end and catch_up while a window runs */
+void TiledWorld::run_tile(unsigned)
+{
+    Event::do_until(window_end);
+    if (catch_up) {
+        /* what redisplay_all does before it draws */
+        if (live_order != ANY_ORDER) LifeForm::sort_living(live_order);
+        LifeForm::advance_all();
+    }
+}
+
+/*
+ * the encounters that were found in the window, in the order they were
+ * found, with the real LifeForms.  both LifeForms may have run into the
+ * other's ghost, but an encounter is only resolved once (and a LifeForm
+ * that has moved next to its own ghost doesn't meet itself)
+ */
+void TiledWorld::resolve_border_encounters(void)
+{
+    set<pair<LifeForm*, LifeForm*>> done;
+    for (Tile& t : tiles) {
+        for (auto& e : t.world->border_encounters) {
+            SmartPointer<LifeForm> me = e.first;
+            SmartPointer<LifeForm> other = as_ghost(e.second).of;
+            LifeForm* a = &*me;
+            LifeForm* b = &*other;
+            if (a == b) continue;
+            if (!done.insert(a < b ? make_pair(a, b) : make_pair(b, a)).second) continue;
+            World::Scope in(me->home());
+            me->resolve_encounter(other);
+        }
+        t.world->border_encounters.clear();
+    }
+}
+
+/* move every LifeForm that is outside its tile to the tile it is in */
+void TiledWorld::migrate(void)
+{
+    struct Move {
+        SmartPointer<LifeForm> who;
+        unsigned from, to;
+    };
+    vector<Move> moving;
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        for (LifeForm* lf : tiles[k].world->all_life.living()) {
+            unsigned dest = tile_at(lf->pos());
+            if (dest != k) moving.push_back(Move{ lf, k, dest });
+        }
+    }
+    if (moving.empty()) return;
+
+    /* a LifeForm may be moving to the very spot where its ghost is */
+    for (Move& m : moving) {
+        drop_ghost(tiles[m.to], &*m.who);
+    }
+
+    /* (moving a LifeForm resizes the regions of others, which may kill them) */
+    vector<unordered_set<const LifeForm*>> left(tiles.size());
+    for (Move& m : moving) {
+        m.who->move_to(*tiles[m.to].world);
+        if (&m.who->home() == &*tiles[m.to].world) left[m.from].insert(&*m.who);
+    }
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        if (!left[k].empty()) Event::move_owned(*tiles[k].world, left[k]);
+    }
+
+    /* the border_cross_events were computed with the old tile's QuadTree */
+    for (Move& m : moving) {
+        if (!m.who->is_alive()) continue;
+        World::Scope in(m.who->home());
+        m.who->region_resize();
+    }
+}
+
+/*
+ * make each tile's ghosts match the LifeForms of the other tiles that
+ * are near it now.  the ghosts are visited in the order they were made,
+ * and new ones are made in the order of all_life, so that the QuadTree
+ * callbacks (and so the run) are the same every time
+ */
+void TiledWorld::refresh_ghosts(void)
+{
+    vector<vector<LifeForm*>> wanted(tiles.size());
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        for (LifeForm* lf : tiles[k].world->all_life.living()) {
+            const Point& p = lf->position();
+            unsigned first = tile_at(Point(p.xpos - ghost_range, p.ypos - ghost_range));
+            unsigned last = tile_at(Point(p.xpos + ghost_range, p.ypos + ghost_range));
+            for (unsigned j = first / across; j <= last / across; j += 1) {
+                for (unsigned i = first % across; i <= last % across; i += 1) {
+                    unsigned t = j * across + i;
+                    if (t != k && near_tile(p, tiles[t])) wanted[t].push_back(lf);
+                }
+            }
+        }
+    }
+
+    for (unsigned t = 0; t < tiles.size(); t += 1) {
+        Tile& tile = tiles[t];
+        World& world = *tile.world;
+        World::Scope in(world);
+
+        unordered_set<LifeForm*> keep(wanted[t].begin(), wanted[t].end());
+        vector<LifeForm*> order;
+        for (LifeForm* of : tile.ghost_order) {
+            if (tile.ghosts.count(of) == 0) continue;   // dropped already
+            if (keep.count(of)) order.push_back(of);
+            else drop_ghost(tile, of);
+        }
+
+        for (LifeForm* of : wanted[t]) {
+            auto g = tile.ghosts.find(of);
+            if (g == tile.ghosts.end()) {
+                if (world.space.is_occupied(of->position())) continue;
+                SmartPointer<LifeForm> ghost = new Ghost(of);
+                ghost->pos() = of->position();
+                world.space.insert(ghost, ghost->pos());
+                g = tile.ghosts.insert(make_pair(of, ghost)).first;
+                order.push_back(of);
+            }
+            else if (g->second->pos() != of->position()
+                     && !world.space.is_occupied(of->position())) {
+                world.space.update_position(g->second->pos(), of->position());
+                g->second->pos() = of->position();
+            }
+            LifeForm& ghost = *g->second;
+            ghost.speed() = of->speed();
+            ghost.course() = of->course();
+            ghost.all_life->energy[ghost.vector_pos] = of->energy();
+        }
+        tile.ghost_order.swap(order);
+    }
+}
+
+void TiledWorld::drop_ghost(Tile& tile, LifeForm* of)
+{
+    auto g = tile.ghosts.find(of);
+    if (g == tile.ghosts.end()) return;
+    World::Scope in(*tile.world);
+    tile.world->space.remove(g->second->pos());
+    /* an event of the tile may still hold the ghost, and let go of it in
+       the tile's thread: the LifeForm must be let go of here, between windows */
+    as_ghost(g->second).of = nullptr;
+    tile.ghosts.erase(g);
+}
+
+/* report the sum of the tiles' species totals, from totals */
+void TiledWorld::add_up(void)
+{
+    totals.species_stats.assign(Species::count(), SpeciesStats());
+    uint32_t num_objects = 0;
+    unsigned num_events = 0;
+    for (Tile& t : tiles) {
+        const World& w = *t.world;
+        for (Species::Id k = 0; k < w.species_stats.size(); k += 1) {
+            SpeciesStats& sum = totals.species_stats[k];
+            const SpeciesStats& s = w.species_stats[k];
+            sum.alive += s.alive;
+            sum.energy += s.energy;
+            sum.births += s.births;
+            sum.deaths += s.deaths;
+            sum.eats += s.eats;
+        }
+        num_objects += w.all_life.size() - (uint32_t) t.ghosts.size();
+        num_events += w.equeue.size();
+    }
+    LifeForm::report(totals, num_objects, num_events);
+}
@@ -0,0 +1,106 @@
+#if !(_TiledWorld_h)
+#define _TiledWorld_h 1
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "World.h"
+
+/*
+ * Class name: TiledWorld
+ * Description:
+ *  One simulation, spread over several threads.  The grid is cut into
+ *  across x across tiles, and each tile is a World of its own (with its
+ *  own event queue and QuadTree) that owns the LifeForms inside it.
+ *
+ *  The tiles are run in windows of tile_lookahead time units, each tile
+ *  by its own thread.  Interactions are local and speeds are bounded, so
+ *  in one window a LifeForm can only meet or see LifeForms that are near
+ *  its own tile.  Those LifeForms are represented in the tile by ghosts:
+ *  copies, made at the start of the window, that can be perceived but
+ *  never change.  Between windows (at the barrier), with every tile
+ *  stopped:
+ *    - encounters with ghosts are resolved, with the real LifeForms
+ *    - LifeForms that have wandered out of their tile move to the tile
+ *      they are in now, with their events (see LifeForm::move_to and
+ *      Event::move_owned)
+ *    - the ghosts are brought up to date
+ *    - the species totals of the tiles are added up into 'totals', which
+ *      reports and decides when to stop, exactly as a World would
+ *
+ *  This is not the serial simulation run faster: an encounter across
+ *  a border happens up to tile_lookahead late, and a ghost is up to
+ *  tile_lookahead out of date.  The species behave the same way, and
+ *  the results are statistically the same (and repeatable, since the
+ *  barrier is serial and each tile has its own random numbers).
+ *
+ *  Usage:
+ *      TiledWorld tiles(2, seed);      // 4 tiles, 4 threads
+ *      tiles.simulate(time_lapse, [](void) { LifeForm::populate(); }, tick);
+ */
+class TiledWorld {
+public:
+    TiledWorld(unsigned across, unsigned long seed = 1, double window = tile_lookahead);
+    virtual ~TiledWorld(void);
+
+    /*
+     * populate is run once, in the first tile, to create the LifeForms
+     * (they move to their own tiles at the first barrier).  tick, if
+     * there is one, is run at each barrier in the first tile, e.g. to add
+     * spores.  The totals are reported every time_lapse time units
+     */
+    void simulate(double time_lapse, const std::function<void(void)>& populate,
+                  const std::function<void(void)>& tick);
+
+    World totals;               // reports for all of the tiles (nothing runs in it)
+
+protected:
+    struct Tile {
+        std::unique_ptr<World> world;
+        double left, bottom, right, top;
+        /* ghosts of the LifeForms of other tiles, by the LifeForm, and
+           the order they were made in */
+        std::unordered_map<LifeForm*, SmartPointer<LifeForm>> ghosts;
+        std::vector<LifeForm*> ghost_order;
+    };
+
+    unsigned across;
+    double side;                // of a tile
+    double window;              // how long the tiles run between barriers
+    double ghost_range;         // how far outside a tile its ghosts are kept
+    std::vector<Tile> tiles;
+
+    unsigned tile_at(const Point&) const;
+    bool near_tile(const Point&, const Tile&) const;
+
+    void resolve_border_encounters(void);
+    void migrate(void);
+    void refresh_ghosts(void);
+    void drop_ghost(Tile&, LifeForm* of);
+    virtual void add_up(void);
+
+    /* the worker threads, one per tile, run a window when generation changes */
+    void work(unsigned k);
+    virtual void run_window(void);
+    virtual void run_tile(unsigned k);  // in tile k's thread, with tile k current
+
+    std::mutex lock;
+    std::condition_variable changed;
+    unsigned long generation = 0;
+    unsigned busy = 0;          // tiles that are still running the window
+    bool quitting = false;
+    SimTime window_end = 0.0;
+    bool catch_up = false;      // bring every LifeForm up to date after the window
+    std::vector<std::thread> workers;
+
+private:
+    TiledWorld(const TiledWorld&) = delete;
+    void operator=(const TiledWorld&) = delete;
+};
+
+#endif /* !(_TiledWorld_h) */
@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include "TimeWarp.h"
+#include "Event.h"
+#include "LifeForm.h"
+#include "Params.h"
+
+using namespace std;
+
+/* Event::seq is (the number of the LP + 1) << seq_bits, plus a count */
+static const unsigned seq_bits = 48;
+
+/*
+ * the members of some LifeForms that are not in their rows, saved one
+ * LifeForm after another
+ */
+struct TimeWarp::Members {
+    vector<double> reproduce_time;
+    vector<Point> start_point;
+    vector<RandomStream> random;
+    vector<Event*> events;              // the values of event_members()
+
+    void save(LifeForm& a, vector<Event**>& scratch) {
+        reproduce_time.push_back(a.reproduce_time);
+        start_point.push_back(a.start_point);
+        random.push_back(a.random);
+        scratch.clear();
+        a.event_members(scratch);
+        for (Event** e : scratch) events.push_back(*e);
+    }
+
+    /* put back the k'th LifeForm saved, whose events start at events[e] */
+    void restore(LifeForm& a, size_t k, size_t& e, vector<Event**>& scratch) const {
+        a.reproduce_time = reproduce_time[k];
+        a.start_point = start_point[k];
+        a.random = random[k];
+        scratch.clear();
+        a.event_members(scratch);
+        for (Event** m : scratch) *m = events[e++];
+    }
+};
+
+/* an event that is not in a queue now, and what it was like when it was */
+struct TimeWarp::Pending {
+    Event* e;
+    SimTime t;
+    bool active;
+};
+
+/*
+ * a LifeForm on its way from one LP to another.  while it is on its way
+ * its row is parked here (so park must outlive who), and its events are
+ * in no queue
+ */
+struct TimeWarp::Message {
+    SimTime t;                          // when it arrives
+    uint64_t seq;                       // the number of its arrival Event
+    unsigned from, to;
+    LifeFormState park;
+    SmartPointer<LifeForm> who;
+    Members members;
+    vector<Pending> events;             // who's events, from the sender's queue
+
+    long drained_at = -1;               // the checkpoint of 'to' before its arrival Event was made
+    Event* arrival = nullptr;
+    bool arrived = false;               // the arrival Event has run
+    bool retracted = false;             // by an anti-message
+};
+
+/* everything that an LP changes as it runs, at one moment */
+struct TimeWarp::Checkpoint {
+    SimTime now;
+    uint64_t next_seq;
+    RandomStream random;
+    uint64_t num_streams;
+    vector<SpeciesStats> species_stats;
+    LifeFormState rows;
+    vector<SmartPointer<LifeForm>> holders;     // keep the LifeForms of rows
+    Members members;                    // of rows, row by row
+    vector<Pending> queue;              // in the order of the heap
+    size_t num_done, num_encounters;
+    size_t num_sent, num_drained, num_arrived;  // the lengths of the LP's lists
+};
+
+struct TimeWarp::LP {
+    World::Bounds bounds;
+    vector<Checkpoint> checkpoints;     // since the last GVT, [0] is at the GVT
+    vector<MessagePtr> sent;            // in the order they were sent
+    vector<MessagePtr> drained;         // in the order their arrival Events were made
+    vector<MessagePtr> arrived;         // in the order their arrival Events ran
+    vector<MessagePtr> stragglers;      // that arrived in the LP's past
+    vector<MessagePtr> later;           // that arrive after the window
+    vector<Event**> scratch;
+    unsigned long num_run = 0;
+    unsigned long num_sent = 0;
+
+    mutex lock;                         // the other LPs post to incoming
+    vector<MessagePtr> incoming;
+    atomic<bool> has_mail{ false };
+};
+
+/*
+ * the LPs are the tiles of a TiledWorld with a window of tw_window, and
+ * the tiles' Worlds keep and number their events, and know their regions
+ */
+TimeWarp::TimeWarp(unsigned n, unsigned long seed)
+    : TiledWorld(n, seed, tw_window)
+{
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        Tile& t = tiles[k];
+        lps.emplace_back(new LP);
+        LP& lp = *lps.back();
+        lp.bounds = World::Bounds{ t.left, t.bottom, t.right, t.top };
+        World& w = *t.world;
+        w.owned = &lp.bounds;
+        w.next_seq = ((uint64_t) (k + 1) << seq_bits) + 1;
+        w.keep_done = true;
+    }
+}
+
+/*
+ * the events of the LifeForms that are still on their way are in no
+ * queue, so no World will delete them
+ */
+TimeWarp::~TimeWarp(void)
+{
+    for (MessagePtr& m : in_flight) {
+        if (m->arrived) continue;
+        World::Scope in(*tiles[m->to].world);
+        for (Pending& p : m->events) delete p.e;
+        m->events.clear();
+    }
+    in_flight.clear();
+}
+
+/*
+ * run the window until no LP has received a straggler, then commit it.
+ * (the first tile's tick and the migrations at the barrier may have left
+ * strays, they are where they belong now)
+ */
+void TimeWarp::run_window(void)
+{
+    num_windows += 1;
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        World::Scope in(*tiles[k].world);
+        tiles[k].world->strays.clear();
+        save(k);
+    }
+    do {
+        num_rounds += 1;
+        TiledWorld::run_window();
+    } while (settle());
+    commit();
+}
+
+/*
+ * run LP k's events up to the end of the window, and send the LifeForms
+ * that leave its region.  stop at the first straggler
+ */
+void TimeWarp::run_tile(unsigned k)
+{
+    LP& lp = *lps[k];
+    World& w = *tiles[k].world;
+    for (;;) {
+        if (lp.has_mail) take_mail(k);
+        if (!lp.stragglers.empty()) return;
+        if (w.equeue.size() == 0 || w.equeue.next_time() >= window_end) break;
+        Event::do_next();
+        lp.num_run += 1;
+        if (!w.strays.empty()) send_strays(k);
+    }
+    if (w.now < window_end) w.now = window_end;
+}
+
+void TimeWarp::save(unsigned k)
+{
+    LP& lp = *lps[k];
+    World& w = *tiles[k].world;
+    lp.checkpoints.emplace_back();
+    Checkpoint& c = lp.checkpoints.back();
+    c.now = w.now;
+    c.next_seq = w.next_seq;
+    c.random = w.random;
+    c.num_streams = w.num_streams;
+    c.species_stats = w.species_stats;
+    c.rows = w.all_life;
+    c.holders.reserve(w.all_life.size());
+    for (LifeForm* lf : w.all_life) {
+        c.holders.push_back(SmartPointer<LifeForm>(lf));
+        c.members.save(*lf, lp.scratch);
+    }
+    c.queue.reserve(w.equeue.size());
+    for (Event* e : w.equeue.contents()) {
+        c.queue.push_back(Pending{ e, e->t, e->active });
+    }
+    c.num_done = w.done.size();
+    c.num_encounters = w.border_encounters.size();
+    c.num_sent = lp.sent.size();
+    c.num_drained = lp.drained.size();
+    c.num_arrived = lp.arrived.size();
+}
+
+/*
+ * a message for the LP's past is a straggler, one for its future gets
+ * an arrival Event (numbered by the sender, so that it runs in the same
+ * order whenever it was received).  one for after the window waits for
+ * the commit
+ */
+void TimeWarp::take_mail(unsigned k)
+{
+    LP& lp = *lps[k];
+    World& w = *tiles[k].world;
+    vector<MessagePtr> mail;
+    {
+        lock_guard<mutex> guard(lp.lock);
+        mail.swap(lp.incoming);
+        lp.has_mail = false;
+    }
+    for (MessagePtr& m : mail) {
+        if (m->t >= window_end) lp.later.push_back(m);
+        else if (m->t <= w.now) lp.stragglers.push_back(m);
+        else {
+            m->drained_at = (long) lp.checkpoints.size() - 1;
+            m->arrival = new Event([this, m](void) { arrive(m); }, m->t, m->seq);
+            lp.drained.push_back(m);
+        }
+    }
+}
+
+/*
+ * send every stray that is still ours to the LP that owns the place it
+ * is in.  (leaving makes the neighbors' regions grow, and they may stray
+ * too.)  the messages are posted after the checkpoint, once this thread
+ * has let go of the strays
+ */
+void TimeWarp::send_strays(unsigned k)
+{
+    World& w = *tiles[k].world;
+    vector<MessagePtr> outbox;
+    while (!w.strays.empty()) {
+        vector<SmartPointer<LifeForm>> strays;
+        strays.swap(w.strays);
+        for (SmartPointer<LifeForm>& s : strays) {
+            if (!s->is_alive() || &s->home() != &w) continue;
+            unsigned dest = tile_at(s->position());
+            if (dest != k) outbox.push_back(send(k, *s, dest));
+        }
+    }
+    if (outbox.empty()) return;
+    save(k);
+    for (MessagePtr& m : outbox) post(m);
+}
+
+/*
+ * take a LifeForm out of LP k (as LifeForm::move_to does, but its row
+ * is parked in the message and its events are taken with it)
+ */
+TimeWarp::MessagePtr TimeWarp::send(unsigned k, LifeForm& a, unsigned dest)
+{
+    LP& lp = *lps[k];
+    World& w = *tiles[k].world;
+    MessagePtr m = make_shared<Message>();
+    m->t = w.now + min_delta_time;
+    m->seq = w.next_seq++;
+    m->from = k;
+    m->to = dest;
+    m->who = SmartPointer<LifeForm>(&a);
+    lp.sent.push_back(m);
+    lp.num_sent += 1;
+
+    w.space.remove(a.pos());
+    SpeciesStats& s = a.stats();
+    s.alive -= 1;
+    s.energy = s.alive ? s.energy - a.energy() : 0.0;
+
+    m->members.save(a, lp.scratch);
+    vector<Event*> taken;
+    LifeForm* owner = &a;
+    w.equeue.take([owner](const Event* e) { return e->owner == owner; }, taken);
+    for (Event* e : taken) {
+        m->events.push_back(Pending{ e, e->t, e->active });
+    }
+
+    uint32_t k0 = a.vector_pos;
+    m->park.push_back(&a, w.all_life, k0);
+    uint32_t g = w.all_life.bury(k0);
+    w.all_life[k0]->vector_pos = k0;
+    LifeForm* last = w.all_life.remove(g);
+    if (last) { last->vector_pos = g; }
+
+    a.world = &*tiles[dest].world;
+    a.all_life = &m->park;
+    a.vector_pos = 0;
+    return m;
+}
+
+void TimeWarp::post(const MessagePtr& m)
+{
+    LP& to = *lps[m->to];
+    lock_guard<mutex> guard(to.lock);
+    to.incoming.push_back(m);
+    to.has_mail = true;
+}
+
+/* the arrival Event: the LifeForm joins its new LP, with its events */
+void TimeWarp::arrive(const MessagePtr& m)
+{
+    LP& lp = *lps[m->to];
+    World& w = *tiles[m->to].world;
+    LifeForm& a = *m->who;
+    m->arrived = true;
+    lp.arrived.push_back(m);
+
+    uint32_t row = w.all_life.push_back(&a, m->park, 0);
+    a.all_life = &w.all_life;
+    a.vector_pos = w.all_life.revive(row);
+    w.all_life[row]->vector_pos = row;
+    SpeciesStats& s = a.stats();
+    s.alive += 1;
+    s.energy += a.energy();
+
+    size_t e = 0;
+    m->members.restore(a, 0, e, lp.scratch);
+    for (const Pending& p : m->events) {
+        p.e->t = std::max(p.t, w.now);
+        p.e->active = p.active;
+        p.e->world = &w;
+        p.e->insert();
+    }
+
+    /* somebody may have taken the very spot while it was on its way */
+    while (w.space.is_occupied(a.pos())) a.pos().xpos += Point::tolerance;
+    SmartPointer<LifeForm> self{ &a };
+    w.space.insert(self, a.pos(), [self](void) { self->region_resize(); });
+    a.region_resize();
+}
+
+/*
+ * at the barrier: find the stragglers (some may have come after their
+ * LP had finished), and where each LP must roll back to, following the
+ * anti-messages.  returns false if no LP has to roll back
+ */
+bool TimeWarp::settle(void)
+{
+    const size_t none = (size_t) -1;
+    const size_t n = lps.size();
+    for (unsigned k = 0; k < n; k += 1) {
+        LP& lp = *lps[k];
+        World& w = *tiles[k].world;
+        lock_guard<mutex> guard(lp.lock);
+        for (MessagePtr& m : lp.incoming) {
+            if (m->t < window_end && m->t <= w.now) lp.stragglers.push_back(m);
+        }
+        auto past = remove_if(lp.incoming.begin(), lp.incoming.end(), [this, &w](const MessagePtr& m) {
+            return m->t < window_end && m->t <= w.now;
+        });
+        lp.incoming.erase(past, lp.incoming.end());
+    }
+
+    vector<size_t> to(n, none);
+    vector<unsigned> work;
+    auto lower = [&to, &work](unsigned k, size_t j) {
+        if (j < to[k]) {
+            to[k] = j;
+            work.push_back(k);
+        }
+    };
+    for (unsigned k = 0; k < n; k += 1) {
+        LP& lp = *lps[k];
+        for (MessagePtr& m : lp.stragglers) {
+            size_t j = lp.checkpoints.size() - 1;
+            while (lp.checkpoints[j].now >= m->t) {
+                assert(j > 0);          // [0] is from before anything was sent
+                j -= 1;
+            }
+            lower(k, j);
+        }
+    }
+    if (work.empty()) return false;
+
+    /* an LP that rolls back takes back what it has sent since, and an LP
+       that has already made an arrival Event for that rolls back too */
+    while (!work.empty()) {
+        unsigned k = work.back();
+        work.pop_back();
+        LP& lp = *lps[k];
+        for (size_t i = lp.checkpoints[to[k]].num_sent; i < lp.sent.size(); i += 1) {
+            Message& m = *lp.sent[i];
+            if (m.retracted) continue;
+            m.retracted = true;
+            num_anti += 1;
+            if (m.drained_at >= 0) lower(m.to, (size_t) m.drained_at);
+        }
+    }
+
+    /* the other retracted messages are just taken out of the mail */
+    auto retracted = [](const MessagePtr& m) { return m->retracted; };
+    for (unsigned k = 0; k < n; k += 1) {
+        LP& lp = *lps[k];
+        lock_guard<mutex> guard(lp.lock);
+        lp.incoming.erase(remove_if(lp.incoming.begin(), lp.incoming.end(), retracted),
+                          lp.incoming.end());
+        lp.stragglers.erase(remove_if(lp.stragglers.begin(), lp.stragglers.end(), retracted),
+                            lp.stragglers.end());
+        lp.later.erase(remove_if(lp.later.begin(), lp.later.end(), retracted), lp.later.end());
+    }
+
+    roll_back(to);
+    return true;
+}
+
+/*
+ * put each LP k that has to[k] set back the way it was at checkpoint
+ * to[k].  this is done in steps, for all of those LPs at once, because
+ * they share LifeForms and Events (through their messages):
+ *   1. empty the LP, and collect the events that it made since the
+ *      checkpoint (and the arrival Events of the messages it has received
+ *      since), which must not exist any more
+ *   2. delete those events (which may destroy LifeForms)
+ *   3. park the LifeForms that have arrived since the checkpoint in their
+ *      messages again
+ *   4. put back the rows, the LifeForms, the queue and the rest
+ *   5. rebuild the QuadTree, without callbacks (it is as it was)
+ * the messages that have been taken back are let go of last
+ */
+void TimeWarp::roll_back(const vector<size_t>& to)
+{
+    const size_t none = (size_t) -1;
+    const size_t n = lps.size();
+    vector<Event*> doomed;
+    vector<MessagePtr> dropped;
+
+    for (unsigned k = 0; k < n; k += 1) {
+        if (to[k] == none) continue;
+        LP& lp = *lps[k];
+        World& w = *tiles[k].world;
+        World::Scope in(w);
+        const Checkpoint& c = lp.checkpoints[to[k]];
+        num_rollbacks += 1;
+        num_undone += w.done.size() - c.num_done;
+
+        w.all_life.bury_all();
+        w.space.clear();
+        w.perceive_cache.clear();
+        w.perceive_sweep.clear();
+        w.strays.clear();
+        w.border_encounters.resize(c.num_encounters);
+        for (Event* e : w.equeue.contents()) e->in_queue = false;
+
+        const uint64_t first = c.next_seq;
+        const uint64_t end = (uint64_t) (k + 2) << seq_bits;
+        auto made_since = [first, end](const Event* e) { return e->seq >= first && e->seq < end; };
+        for (Event* e : w.equeue.contents()) {
+            if (made_since(e)) doomed.push_back(e);
+        }
+        for (size_t i = c.num_done; i < w.done.size(); i += 1) {
+            if (made_since(w.done[i])) doomed.push_back(w.done[i]);
+        }
+        for (size_t i = c.num_sent; i < lp.sent.size(); i += 1) {
+            for (Pending& p : lp.sent[i]->events) {
+                if (made_since(p.e)) doomed.push_back(p.e);
+            }
+        }
+        for (size_t i = c.num_drained; i < lp.drained.size(); i += 1) {
+            doomed.push_back(lp.drained[i]->arrival);
+        }
+    }
+
+    /* (a LifeForm that has come back may carry an event to delete twice) */
+    sort(doomed.begin(), doomed.end());
+    doomed.erase(unique(doomed.begin(), doomed.end()), doomed.end());
+    for (unsigned k = 0; k < n; k += 1) {
+        if (to[k] == none) continue;
+        lps[k]->checkpoints.resize(to[k] + 1);
+    }
+    for (Event* e : doomed) {
+        e->in_queue = false;
+        delete e;
+    }
+
+    /* a LifeForm may have travelled on several of these messages: the
+       first of them (the earliest) is where it must be parked */
+    vector<MessagePtr> parking;
+    for (unsigned k = 0; k < n; k += 1) {
+        if (to[k] == none) continue;
+        LP& lp = *lps[k];
+        const Checkpoint& c = lp.checkpoints.back();
+        parking.insert(parking.end(), lp.arrived.begin() + c.num_arrived, lp.arrived.end());
+        lp.arrived.resize(c.num_arrived);
+    }
+    stable_sort(parking.begin(), parking.end(),
+                [](const MessagePtr& a, const MessagePtr& b) { return a->t > b->t; });
+    for (MessagePtr& m : parking) {
+        m->who->world = &*tiles[m->to].world;
+        m->who->all_life = &m->park;
+        m->who->vector_pos = 0;
+        m->arrived = false;
+    }
+    parking.clear();
+
+    for (unsigned k = 0; k < n; k += 1) {
+        if (to[k] == none) continue;
+        LP& lp = *lps[k];
+        World& w = *tiles[k].world;
+        const Checkpoint& c = lp.checkpoints.back();
+
+        w.all_life = c.rows;
+        size_t e = 0;
+        for (uint32_t r = 0; r < w.all_life.size(); r += 1) {
+            LifeForm& a = *w.all_life[r];
+            a.world = &w;
+            a.all_life = &w.all_life;
+            a.vector_pos = r;
+            c.members.restore(a, r, e, lp.scratch);
+        }
+        vector<Event*> queue;
+        queue.reserve(c.queue.size());
+        for (const Pending& p : c.queue) {
+            p.e->t = p.t;
+            p.e->active = p.active;
+            p.e->world = &w;
+            p.e->in_queue = true;
+            queue.push_back(p.e);
+        }
+        w.equeue.assign(queue);
+        w.done.resize(c.num_done);
+        w.now = c.now;
+        w.next_seq = c.next_seq;
+        w.random = c.random;
+        w.num_streams = c.num_streams;
+        w.species_stats = c.species_stats;
+
+        /* what it has been sent since will be received again, unless
+           it has been taken back */
+        lock_guard<mutex> guard(lp.lock);
+        dropped.insert(dropped.end(), lp.sent.begin() + c.num_sent, lp.sent.end());
+        lp.sent.resize(c.num_sent);
+        for (size_t i = c.num_drained; i < lp.drained.size(); i += 1) {
+            MessagePtr& m = lp.drained[i];
+            m->drained_at = -1;
+            m->arrival = nullptr;
+            if (!m->retracted) lp.incoming.push_back(m);
+        }
+        lp.drained.resize(c.num_drained);
+        for (MessagePtr& m : lp.stragglers) {
+            lp.incoming.push_back(m);
+        }
+        lp.stragglers.clear();
+        lp.has_mail = !lp.incoming.empty();
+    }
+
+    for (unsigned k = 0; k < n; k += 1) {
+        if (to[k] == none) continue;
+        World& w = *tiles[k].world;
+        World::Scope in(w);
+        for (LifeForm* lf : w.all_life.living()) {
+            SmartPointer<LifeForm> self{ lf };
+            w.space.restore(self, lf->position(), [self](void) { self->region_resize(); });
+        }
+        for (auto& g : tiles[k].ghosts) {
+            w.space.restore(g.second, g.second->position(), [](void) {});
+        }
+    }
+    /* a LifeForm may be parked in one dropped message and held by another */
+    for (MessagePtr& m : dropped) m->who = nullptr;
+    dropped.clear();
+}
+
+/*
+ * the end of the window is the GVT: let go of the past (deleting the
+ * events that have run may destroy LifeForms, so each LP is current while
+ * its own are deleted), and make the arrival Events for the messages
+ * that arrive after it
+ */
+void TimeWarp::commit(void)
+{
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        LP& lp = *lps[k];
+        World& w = *tiles[k].world;
+        World::Scope in(w);
+        {
+            lock_guard<mutex> guard(lp.lock);
+            lp.later.insert(lp.later.end(), lp.incoming.begin(), lp.incoming.end());
+            lp.incoming.clear();
+            lp.has_mail = false;
+        }
+        vector<Event*> done;
+        done.swap(w.done);
+        for (Event* e : done) delete e;
+        lp.checkpoints.clear();
+        lp.sent.clear();
+        lp.drained.clear();
+        lp.arrived.clear();
+        num_run += lp.num_run;
+        num_sent += lp.num_sent;
+        lp.num_run = lp.num_sent = 0;
+    }
+
+    in_flight.erase(remove_if(in_flight.begin(), in_flight.end(),
+                              [](const MessagePtr& m) { return m->arrived; }),
+                    in_flight.end());
+    for (unsigned k = 0; k < tiles.size(); k += 1) {
+        LP& lp = *lps[k];
+        World::Scope in(*tiles[k].world);
+        for (MessagePtr& m : lp.later) {
+            m->arrival = new Event([this, m](void) { arrive(m); }, m->t, m->seq);
+            in_flight.push_back(m);
+        }
+        lp.later.clear();
+    }
+}
+
+/* the totals, and how much of the work was wasted */
+void TimeWarp::add_up(void)
+{
+    TiledWorld::add_up();
+    if (totals.metrics) return;
+    ostringstream out;
+    out << "Time Warp: " << num_windows << " windows in " << num_rounds << " rounds, "
+        << num_run << " events run, " << num_undone << " rolled back ("
+        << 100.0 * rollback_ratio() << "%) in " << num_rollbacks << " rollbacks, "
+        << num_sent << " messages, " << num_anti << " anti-messages\n";
+    cout << out.str();
+}
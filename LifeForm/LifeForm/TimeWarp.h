@@ -0,0 +1,108 @@
+#if !(_TimeWarp_h)
+#define _TimeWarp_h 1
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TiledWorld.h"
+
+/*
+ * Class name: TimeWarp
+ * Description:
+ *  One simulation, run optimistically on several threads.  The grid is
+ *  cut into tiles as in a TiledWorld, but each tile is a logical process
+ *  (LP) that owns the LifeForms in its region and runs its events without
+ *  waiting for the others.  A LifeForm that leaves the region is sent,
+ *  with its row and its events, to the LP that owns the place it is in
+ *  now, in a message that arrives min_delta_time later.  A message that
+ *  arrives in the receiver's past (a straggler) makes the receiver roll
+ *  back to a checkpoint from before the message, and run forward again
+ *  from there; the messages it sent since that checkpoint are taken back
+ *  (anti-messages), which may roll back their receivers in turn.
+ *
+ *  The LPs run in windows of tw_window time units:
+ *    - each LP saves a checkpoint at the start of the window, and another
+ *      after each batch of messages it sends (the only way LPs affect
+ *      each other), so a rollback goes back to the last checkpoint before
+ *      the straggler and coasts forward from there
+ *    - an LP that receives a straggler stops.  When every LP has stopped,
+ *      the rollbacks (and the anti-messages that they cause) are done all
+ *      at once, and the LPs run again, until none of them has received a
+ *      straggler
+ *  The end of the window is then the global virtual time (GVT): nothing
+ *  before it can be rolled back any more, so the checkpoints and the
+ *  events that have run are thrown away (fossil collection), and the
+ *  barrier work of a TiledWorld is done (encounters with ghosts, ghosts,
+ *  spores and reports).
+ *
+ *  The LifeForms and Events are the same as in a World.  An LP keeps the
+ *  Events that have run (World::keep_done) instead of deleting them, and
+ *  it numbers its Events (World::next_seq), so that Events at the same
+ *  time always run in the same order, and running forward again does
+ *  exactly what it did the first time.  A checkpoint holds everything an
+ *  LP changes: its rows of all_life, its queue, the species totals, the
+ *  random numbers, and the members of each LifeForm that are not in its
+ *  row (see LifeForm::event_members).  A species with state of its own
+ *  beyond those would not be rolled back (none of the species here has
+ *  any).
+ *
+ *  The results are the same every time, whatever the threads' timing
+ *  (only how much work is rolled back depends on it).  Each report says
+ *  how much that was (rollback_ratio).
+ *
+ *  Usage:
+ *      TimeWarp lps(2, seed);          // 4 LPs, 4 threads
+ *      lps.simulate(time_lapse, [](void) { LifeForm::populate(); }, tick);
+ */
+class TimeWarp : public TiledWorld {
+public:
+    TimeWarp(unsigned across, unsigned long seed = 1);
+    ~TimeWarp(void);
+
+    unsigned long events_run(void) const { return num_run; }   // including those rolled back
+    unsigned long events_rolled_back(void) const { return num_undone; }
+    double rollback_ratio(void) const {
+        return num_run ? (double) num_undone / (double) num_run : 0.0;
+    }
+
+private:
+    struct Members;
+    struct Pending;
+    struct Message;
+    struct Checkpoint;
+    struct LP;
+    typedef std::shared_ptr<Message> MessagePtr;
+
+    std::vector<std::unique_ptr<LP>> lps;
+    std::vector<MessagePtr> in_flight;  // sent before the last GVT, not yet arrived
+
+    unsigned long num_windows = 0;
+    unsigned long num_rounds = 0;       // runs of a window, including the first
+    unsigned long num_run = 0;
+    unsigned long num_undone = 0;
+    unsigned long num_rollbacks = 0;
+    unsigned long num_sent = 0;
+    unsigned long num_anti = 0;
+
+    void run_window(void);
+    void run_tile(unsigned k);
+    void add_up(void);
+
+    /* in LP k's thread */
+    void save(unsigned k);
+    void take_mail(unsigned k);
+    void send_strays(unsigned k);
+    MessagePtr send(unsigned k, LifeForm&, unsigned dest);
+    void post(const MessagePtr&);
+    void arrive(const MessagePtr&);
+
+    /* at the barrier */
+    bool settle(void);
+    void roll_back(const std::vector<size_t>& to);
+    void commit(void);
+};
+
+#endif /* !(_TimeWarp_h) */
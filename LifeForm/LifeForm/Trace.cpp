@@ -0,0 +1,231 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "Trace.h"
+#include "LifeForm.h"
+#include "Packet.h"
+#include "World.h"
+
+using namespace std;
+
+const string Trace::header = "EPL trace 1";
+
+static_assert(sizeof(RandomStream) == 2 * sizeof(uint64_t), "a STREAM Record holds a RandomStream in a and b");
+
+/* a double, bit for bit, in a uint64_t field of a Record */
+static uint64_t bits(double x) {
+    uint64_t b;
+    memcpy(&b, &x, sizeof(b));
+    return b;
+}
+
+Trace::Trace(const string& target, World& w) : world(w), ring(ring_size)
+{
+    out = fopen(target.c_str(), "wb");
+    if (out == nullptr) {
+        cerr << "Trace: cannot open " << target << "\n";
+        good = false;
+        return;
+    }
+
+    Packet p;
+    p.put_string(header);
+    p.put((uint64_t) world.seed);
+    vector<Event::Kind> all = Event::all_kinds();
+    p.put((uint32_t) all.size());
+    for (size_t k = 0; k < all.size(); k += 1) {
+        kinds[all[k]] = (uint16_t) k;
+        p.put_string(*Event::kind_name(all[k]));
+    }
+    p.put((uint32_t) Species::count());
+    for (Species::Id k = 0; k < Species::count(); k += 1) {
+        p.put_string(Species::at(k).name());
+    }
+    fwrite(p.bytes.data(), 1, p.bytes.size(), out);
+    writer = thread([this](void) { run_writer(); });
+}
+
+void Trace::close(void)
+{
+    if (!writer.joinable()) return;
+    closing = true;
+    writer.join();
+    if (fclose(out) != 0) failed = true;
+    out = nullptr;
+    if (failed) cerr << "Trace: the trace could not be written\n";
+}
+
+bool Trace::species_kind(Event::Kind k)
+{
+    return k != nullptr && k != &LifeForm::on_age && k != &LifeForm::on_digest
+        && k != &LifeForm::on_border_cross;
+}
+
+/* wait (only) if the writer is a whole ring behind */
+void Trace::put(const Record& r)
+{
+    size_t h = head.load(memory_order_relaxed);
+    while (h - tail.load(memory_order_acquire) >= ring_size) {
+        this_thread::yield();
+    }
+    ring[h % ring_size] = r;
+    head.store(h + 1, memory_order_release);
+    num_records += 1;
+}
+
+/* write Records as they are put, until close is called and nothing is left */
+void Trace::run_writer(void)
+{
+    for (;;) {
+        bool last = closing.load(memory_order_acquire);
+        size_t t = tail.load(memory_order_relaxed);
+        size_t h = head.load(memory_order_acquire);
+        if (t == h) {
+            if (last) return;
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+        size_t from = t % ring_size;
+        size_t n = min(h - t, ring_size - from);
+        if (fwrite(&ring[from], sizeof(Record), n, out) != n) failed = true;
+        tail.store(t + n, memory_order_release);
+    }
+}
+
+Trace::Record Trace::make(What what, const LifeForm* who, const LifeForm* target) const
+{
+    Record r{};
+    r.time = world.now;
+    r.who = who ? who->handle : 0;
+    r.target = target ? target->handle : 0;
+    r.what = what;
+    return r;
+}
+
+void Trace::sync(void)
+{
+    Frame& f = frames.back();
+    if (f.who->random == f.synced) return;
+    Record r = make(STREAM, f.who, f.who);
+    memcpy(&r.a, &f.who->random, sizeof(RandomStream));
+    put(r);
+    f.synced = f.who->random;
+}
+
+/* an event of a species' own kind is a call into species code */
+void Trace::run(Event& e)
+{
+    bool species = e.active && e.owner && species_kind(e.kind);
+    Record r = make(species ? CALL : DISPATCH, e.owner, nullptr);
+    auto k = kinds.find(e.kind);
+    r.kind = k == kinds.end() ? 0xffff : k->second;
+    r.a = e.active;
+    put(r);
+    if (!species) {
+        e();
+        return;
+    }
+    frames.push_back(Frame{ e.owner, e.owner->random, 0 });
+    e();
+    sync();
+    frames.pop_back();
+}
+
+Action Trace::encounter(LifeForm& lf, LifeForm& other, const ObjInfo& info)
+{
+    put(make(ENCOUNTER, &lf, &other));
+    frames.push_back(Frame{ &lf, lf.random, 0 });
+    Action a = lf.encounter(info);
+    sync();
+    frames.pop_back();
+    Record r = make(ACTION, &lf, &other);
+    r.a = a;
+    put(r);
+    return a;
+}
+
+/*
+ * what species code does is part of the call it is made in.  outside of
+ * any call (e.g., in the constructor of a LifeForm that populate makes)
+ * it is part of what the LifeForm it is done to does
+ */
+bool Trace::scheduled(const Event& e, SimTime delta)
+{
+    if (!e.owner || !species_kind(e.kind)) return false;
+    Record r = make(SCHEDULE, in_species() ? frames.back().who : e.owner, e.owner);
+    r.kind = kinds[e.kind];
+    r.a = bits(delta);
+    r.b = bits(e.arg);
+    put(r);
+    return true;
+}
+
+void Trace::cancelled(const Event& e)
+{
+    Record r = make(CANCEL, in_species() ? frames.back().who : e.owner, e.owner);
+    r.kind = kinds[e.kind];
+    r.a = bits(e.t);
+    r.b = bits(e.arg);
+    put(r);
+}
+
+void Trace::made(const LifeForm& lf)
+{
+    if (in_species()) put(make(NEW, frames.back().who, &lf));
+}
+
+void Trace::born(const LifeForm& lf)
+{
+    Record r = make(BIRTH, &lf, nullptr);
+    r.kind = lf.species().index();
+    put(r);
+}
+
+void Trace::died(const LifeForm& lf)
+{
+    put(make(DEATH, &lf, nullptr));
+}
+
+void Trace::ate(const LifeForm& lf, const LifeForm& eaten)
+{
+    put(make(EAT, &lf, &eaten));
+}
+
+void Trace::energy(const LifeForm& lf, double delta)
+{
+    if (!in_species()) return;
+    Record r = make(ENERGY, frames.back().who, &lf);
+    r.a = bits(delta);
+    put(r);
+}
+
+/* (a REPRODUCE Record's target is the parent, and b is the child) */
+Trace::Api::Api(LifeForm& lf, What what, double a, const LifeForm* child)
+    : trace(lf.home().trace)
+{
+    if (trace == nullptr || trace->frames.empty()) {
+        trace = nullptr;
+        return;
+    }
+    if (trace->in_species()) {
+        trace->sync();
+        Record r = trace->make(what, trace->frames.back().who, &lf);
+        r.a = bits(a);
+        if (child) {
+            r.b = child->handle;
+            r.kind = child->species().index();
+        }
+        trace->put(r);
+    }
+    trace->frames.back().api += 1;
+}
+
+/* what the simulator drew from the stream isn't species code drawing */
+Trace::Api::~Api(void)
+{
+    if (trace == nullptr) return;
+    Frame& f = trace->frames.back();
+    f.api -= 1;
+    if (f.api == 0) f.synced = f.who->random;
+}
@@ -0,0 +1,148 @@
+#if !(_Trace_h)
+#define _Trace_h 1
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Event.h"
+#include "LifeForm.h"
+#include "Random.h"
+
+class World;
+
+/*
+ * Class name: Trace
+ * Description:
+ *  Records what happens in a World, as a binary log that a Replay (see
+ *  Replay.h) can drive the same simulation from again, and that can be
+ *  compared with the log of another run to find where the two part.
+ *
+ *  The log is a header (the seed of the World, and the names of the
+ *  event kinds and of the species, so that the numbers below mean the
+ *  same thing to another program), followed by fixed size Records.
+ *  Every LifeForm is named by its handle (the number of its
+ *  RandomStream, see World::new_stream).
+ *  There are three sorts of Record:
+ *    - what happened: every event that is run (DISPATCH, or CALL if it
+ *      runs species code, see below), and every BIRTH, DEATH and EAT
+ *    - the calls into species code: CALL (an event of a species' own kind)
+ *      and ENCOUNTER (LifeForm::encounter), which ends with the ACTION
+ *      that was chosen
+ *    - what species code did, through the protected interface of
+ *      LifeForm, during a call (or in a constructor): COURSE, SPEED,
+ *      PERCEIVE, REPRODUCE, NEW (a LifeForm was made), ENERGY (only
+ *      Algae, which is a friend, changes its energy itself), SCHEDULE
+ *      and CANCEL (events of its own kinds), and STREAM (its
+ *      RandomStream has moved on, as of the Record after it)
+ *  The simulator's own work (moving, aging, encounters, eating, ...) is
+ *  not recorded, a Replay does it again.
+ *
+ *  The simulation puts Records in a ring buffer and goes on; a
+ *  background thread writes them out.  If the thread falls a whole ring
+ *  behind, the simulation waits for it.
+ *
+ *  Only events made from a Kind (see Event.h) are recorded as species
+ *  code, so only species that use kinds can be replayed.
+ *
+ *  Usage:
+ *      Trace t("run.trace", world);
+ *      world.trace = &t;       // before anything is simulated
+ *      ...
+ *      world.trace = nullptr;
+ *      t.close();
+ */
+class Trace {
+public:
+    enum What : uint16_t {
+        DISPATCH, CALL, BIRTH, DEATH, EAT,
+        ENCOUNTER, ACTION,
+        COURSE, SPEED, PERCEIVE, REPRODUCE, NEW, ENERGY, SCHEDULE, CANCEL, STREAM
+    };
+
+    /* (numbers are kept bit for bit, so a and b also hold doubles) */
+    struct Record {
+        double time;
+        uint64_t who;           // whose call this is part of (or who it is about)
+        uint64_t target;        // the LifeForm it was done to, or the other one
+        uint64_t a, b;
+        uint16_t what;
+        uint16_t kind;          // event kind or species, by number in the header
+        uint32_t spare;
+    };
+
+    Trace(const std::string& target, World&);
+    ~Trace(void) { close(); }
+
+    bool ok(void) const { return good; }
+    void close(void);           // write out everything recorded so far
+    unsigned long records(void) const { return num_records; }
+
+    static const std::string header;    // the first thing in every trace
+    static bool species_kind(Event::Kind);  // not one of LifeForm's own
+
+    /*
+     * the hooks, called by Event and LifeForm when their World has a
+     * Trace.  run runs the event
+     */
+    void run(Event&);
+    Action encounter(LifeForm&, LifeForm& other, const ObjInfo&);
+    bool scheduled(const Event&, SimTime delta);    // true if it is a species' event
+    void cancelled(const Event&);
+    void made(const LifeForm&);
+    void born(const LifeForm&);
+    void died(const LifeForm&);
+    void ate(const LifeForm&, const LifeForm& eaten);
+    void energy(const LifeForm&, double delta);
+
+    /*
+     * set_course, set_speed, perceive and reproduce hold an Api while
+     * they run: what species code asked for is recorded, and what they
+     * do in turn (e.g., moving, paying for it) is not
+     */
+    class Api {
+        Trace* trace;
+    public:
+        Api(LifeForm&, What, double a, const LifeForm* child = nullptr);
+        ~Api(void);
+    };
+
+private:
+    static const size_t ring_size = 1 << 16;
+
+    /* a call into species code that is under way */
+    struct Frame {
+        LifeForm* who;
+        RandomStream synced;    // its stream, as of the last STREAM Record
+        int api;                // how many Apis are open
+    };
+
+    void put(const Record&);
+    Record make(What, const LifeForm* who, const LifeForm* target) const;
+    bool in_species(void) const { return !frames.empty() && frames.back().api == 0; }
+    void sync(void);            // a STREAM Record, if the current call has drawn
+    void run_writer(void);      // the background thread
+
+    World& world;
+    FILE* out = nullptr;
+    bool good = true;
+    bool failed = false;        // (only the writer sets it, until it is joined)
+    unsigned long num_records = 0;
+    std::unordered_map<Event::Kind, uint16_t> kinds;
+    std::vector<Frame> frames;
+
+    std::vector<Record> ring;
+    std::atomic<size_t> head{ 0 };  // the next Record to put (only the simulation changes it)
+    std::atomic<size_t> tail{ 0 };  // the next Record to write (only the writer changes it)
+    std::atomic<bool> closing{ false };
+    std::thread writer;
+
+    Trace(const Trace&) = delete;
+    void operator=(const Trace&) = delete;
+};
+
+#endif /* !(_Trace_h) */
@@ -1,13 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 #if !(NO_WINDOW)
 #include <FL/fl_draw.H>
-#include <FL/Fl_Group.H>
 #include <FL/Fl.H>
-#include <FL/Fl_Box.H>
+#include <FL/Fl_Widget.H>
 #include <FL/Fl_Window.H>
-#include <FL/x.H>
 #endif
 
 #if defined(_AIX) && !defined(XLC_IS_STUPID) && !defined(__GNUG__)
@@ -21,56 +21,70 @@ using namespace std;
 #endif /* DEBUG */
 
 #include "Window.h"
+#include "FrameWriter.h"
+
+/* the red, green and blue values of each Color */
+static const unsigned char color_map[8][3] = {
+    {   0,   0,   0 },      // BLACK
+    {   0,   0, 255 },      // BLUE
+    {   0, 255,   0 },      // GREEN
+    {   0, 255, 255 },      // CYAN
+    { 255,   0, 255 },      // MAGENTA
+    { 255,   0,   0 },      // RED
+    { 255, 165,   0 },      // ORANGE
+    { 255, 255,   0 }       // YELLOW
+};
 
-/* Allocate colors in an X color map and set them up. */
-void Canvas::initcolor()
-{
-#if !(NO_WINDOW) 
-
-  color_map[BLACK] = FL_BLACK;
-  color_map[GREEN] = FL_GREEN;
-  color_map[CYAN] = FL_CYAN;
-  color_map[MAGENTA] = FL_MAGENTA;
-  color_map[RED] = FL_RED;
-  color_map[ORANGE] = fl_rgb_color(255, 165, 0);
-  color_map[YELLOW] = FL_YELLOW;
-  color_map[BLUE] = FL_BLUE;
-
-#endif /* !(NO_WINDOW) */
-}
-
+#if !(NO_WINDOW)
 /*
-    Set up the mapping of color numbers into monochrome values.
-    Change the raster operations to the logically opposite functions
-    if black is pixel #1.
-*/
-unsigned int Canvas::initmono(void)
-{
-    color_map[BLACK] = FL_BLACK;
-    for (int i = 1; i < 8; i++)
-      color_map[i] = FL_WHITE;
-    return 0;
-}
+ * the only widget in the window, it copies the Canvas's pixels to the
+ * screen whenever FLTK asks for the window to be drawn
+ */
+class FrameView : public Fl_Widget {
+    const std::vector<unsigned char>& pixels;
+public:
+    FrameView(int w, int h, const std::vector<unsigned char>& p) : Fl_Widget(0, 0, w, h), pixels(p) {}
+    void draw() {
+        fl_draw_image(pixels.data(), x(), y(), w(), h(), 3);
+    }
+};
+#endif /* !(NO_WINDOW) */
 
 /*
-   Main procedure:  initialize X display, set up monochrome or color
-   mapping, create a window, wait for it to be mapped, draw rectangles
-   in various forms, and exit.
+   Main procedure:  create a window that holds nothing but a view of
+   the pixels.
 */
-Canvas::Canvas(int w, int h) : width(w), height(h)
+Canvas::Canvas(int w, int h, bool windowed) : width(w), height(h), color(BLACK),
+    pixels((size_t) w * (size_t) h * 3, 0), recorder(nullptr)
 {
 #if !(NO_WINDOW)
 
-    window = new Fl_Double_Window(w, h, "LifeForm Simulation");
-    initcolor();
+    window = nullptr;
+    view = nullptr;
+    if (windowed) {
+        window = new Fl_Double_Window(w, h, "LifeForm Simulation");
+        view = new FrameView(w, h, pixels);
+        window->end();
+    }
 
+#else
+    (void) windowed;
 #endif /* !(NO_WINDOW) */
 }
 
+Canvas::~Canvas()
+{
+#if (RENDER_THREAD)
+    stop_render_thread();
+#endif /* RENDER_THREAD */
+    stop_recording();
+}
+
 void Canvas::display(void)
 {
 #if !(NO_WINDOW)
 
+    if (!window) return;
     window->color(FL_BLACK);
     window->show();
     Fl::wait(0);
@@ -81,11 +95,7 @@ void Canvas::display(void)
 
 void Canvas::set_color(Color x)
 {
-#if !(NO_WINDOW)
-
     color = x;
-
-#endif
 }
 
 int point_size = 3;
@@ -94,10 +104,98 @@ void Canvas::draw_point(int x, int y)
     draw_rectangle(x, y, x + point_size, y + point_size, true);
 }
 
-void Canvas::flush(void) 
+void Canvas::draw_rectangle(int x1, int y1, int x2, int y2, bool filled)
+{
+    if (filled) {
+        commands.push_back(DrawCommand{ DrawCommand::FILL, color, x1, y1, x2, y2 });
+    }
+    else {                      // a one pixel frame, just inside the box
+        commands.push_back(DrawCommand{ DrawCommand::FILL, color, x1, y1, x2, y1 + 1 });
+        commands.push_back(DrawCommand{ DrawCommand::FILL, color, x1, y2 - 1, x2, y2 });
+        commands.push_back(DrawCommand{ DrawCommand::FILL, color, x1, y1, x1 + 1, y2 });
+        commands.push_back(DrawCommand{ DrawCommand::FILL, color, x2 - 1, y1, x2, y2 });
+    }
+}
+
+void Canvas::draw_line(int x1, int y1, int x2, int y2)
+{
+    commands.push_back(DrawCommand{ DrawCommand::LINE, color, x1, y1, x2, y2 });
+}
+
+void Canvas::clear(void)
+{
+    set_color(BLACK);
+    commands.clear();
+}
+
+bool Canvas::watched(void) const
 {
 #if !(NO_WINDOW)
+    if (window) return true;
+#endif /* !(NO_WINDOW) */
+    return recorder != nullptr;
+}
+
+/* turn a display list into pixels, on a black background */
+void Canvas::rasterize(const DisplayList& list, std::vector<unsigned char>& px) const
+{
+    px.assign((size_t) width * (size_t) height * 3, 0);
+
+    for (const DrawCommand& c : list) {
+        const unsigned char* rgb = color_map[c.color];
+        if (c.kind == DrawCommand::FILL) {
+            /* the pixels x1 <= x < x2, y1 <= y < y2 (the same pixels as an Fl_Box) */
+            int x1 = std::max(c.x1, 0), x2 = std::min(c.x2, width);
+            int y1 = std::max(c.y1, 0), y2 = std::min(c.y2, height);
+            for (int y = y1; y < y2; y++) {
+                unsigned char* p = &px[((size_t) y * width + x1) * 3];
+                for (int x = x1; x < x2; x++) {
+                    *p++ = rgb[0];
+                    *p++ = rgb[1];
+                    *p++ = rgb[2];
+                }
+            }
+        }
+        else {
+            /* Bresenham's line, including both end points */
+            int x = c.x1, y = c.y1;
+            int dx = abs(c.x2 - x), sx = x < c.x2 ? 1 : -1;
+            int dy = -abs(c.y2 - y), sy = y < c.y2 ? 1 : -1;
+            int err = dx + dy;
+            for (;;) {
+                if (x >= 0 && x < width && y >= 0 && y < height) {
+                    unsigned char* p = &px[((size_t) y * width + x) * 3];
+                    p[0] = rgb[0];
+                    p[1] = rgb[1];
+                    p[2] = rgb[2];
+                }
+                if (x == c.x2 && y == c.y2) break;
+                int e2 = 2 * err;
+                if (e2 >= dy) { err += dy; x += sx; }
+                if (e2 <= dx) { err += dx; y += sy; }
+            }
+        }
+    }
+}
 
+#if !(RENDER_THREAD)
+
+/* show (and save) everything drawn since the last clear */
+void Canvas::flush(void)
+{
+    if (!watched()) return;
+    rasterize(commands, pixels);
+    num_drawn += 1;
+    if (recorder) recorder->write(pixels.data());
+    present();
+}
+
+void Canvas::present(void)
+{
+#if !(NO_WINDOW)
+
+    if (!window) return;
+    view->redraw();
 #if defined (__APPLE__)
     Fl::flush();
 #else
@@ -107,59 +205,147 @@ void Canvas::flush(void)
 #endif
 }
 
+bool Canvas::record(const std::string& target)
+{
+    stop_recording();
+    recorder = new FrameWriter(target, width, height);
+    if (!recorder->ok()) {
+        stop_recording();
+        return false;
+    }
+    return true;
+}
 
-void Canvas::draw_rectangle(int x1, int y1, int x2, int y2, bool fill)
+void Canvas::stop_recording(void)
 {
-#if !(NO_WINDOW)
+    delete recorder;            // waits for the frames to be written
+    recorder = nullptr;
+}
 
-    Fl_Box *box;
-    if (fill) {
-        box = new Fl_Box(x1, y1, (x2 - x1), (y2 - y1));
-        box->color(color_map[color]);
-        box->box(FL_FLAT_BOX);
+unsigned long Canvas::frames_drawn(void) { return num_drawn; }
+unsigned long Canvas::frames_dropped(void) { return num_dropped; }
+
+#else /* RENDER_THREAD */
+
+/*
+ * hand a snapshot of everything drawn since the last clear to the
+ * render thread (replacing any snapshot it has not started on, unless
+ * frames are being saved), and show the newest frame it has finished
+ */
+void Canvas::flush(void)
+{
+    if (!watched()) return;
+    if (!renderer.joinable()) {
+        renderer = std::thread([this](void) { render_loop(); });
     }
-    else {
-        box = new Fl_Box(x1, y1, (x2 - x1), (y2 - y1));
-        box->color(color_map[color]);
-        box->box(FL_BORDER_FRAME);
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (recorder) changed.wait(guard, [this](void) { return !has_pending; });
+        if (has_pending) num_dropped += 1;
+        pending.assign(commands.begin(), commands.end());
+        has_pending = true;
+        changed.notify_all();
     }
-    window->add(box);
-    box->redraw();
-
-#endif /* !(NO_WINDOW) */
+    present();
 }
 
-class DrawLine : public Fl_Widget {
-public:
-    DrawLine(int X, int Y, int W, int H, const char*L = 0) : Fl_Widget(X, Y, W, H, L) {
+void Canvas::present(void)
+{
+    bool fresh = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (has_ready) {
+            pixels.swap(ready);
+            has_ready = false;
+            fresh = true;
+        }
     }
-    void draw() {
-        // DRAW BLACK 'X'
-        fl_color(FL_BLACK);
-        int x1 = x(), y1 = y();
-        int x2 = x() + w() - 1, y2 = y() + h() - 1;
-        fl_line(x1, y1, x2, y2);
-        fl_line(x1, y2, x2, y1);
+#if !(NO_WINDOW)
+
+    if (!window) return;
+    if (fresh) view->redraw();
+    Fl::check();                // handle window events, but never wait for them
+
+#else
+    (void) fresh;
+#endif
+}
+
+void Canvas::render_loop(void)
+{
+    DisplayList list;
+    std::vector<unsigned char> back;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        changed.wait(guard, [this](void) { return stopping || has_pending; });
+        if (!has_pending) return;       // stopping, and every snapshot is drawn
+        list.swap(pending);
+        has_pending = false;
+        busy = true;
+        changed.notify_all();           // (flush may be waiting to hand over the next one)
+        guard.unlock();
+
+        rasterize(list, back);
+        if (recorder) recorder->write(back.data());
+
+        guard.lock();
+        back.swap(ready);
+        has_ready = true;
+        busy = false;
+        num_drawn += 1;
+        changed.notify_all();
     }
-};
-void Canvas::draw_line(int x1, int y1, int x2, int y2)
+}
+
+void Canvas::finish_frames(void)
 {
-#if !(NO_WINDOW)
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this](void) { return !has_pending && !busy; });
+}
 
-    DrawLine drawLine(x1, y1, x2, y2);
-    window->add(drawLine);
-    drawLine.redraw();
+void Canvas::stop_render_thread(void)
+{
+    if (!renderer.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    renderer.join();
+}
 
-#endif /* !(NO_WINDOW) */
+/* the render thread uses recorder, so it must be idle when recorder changes */
+bool Canvas::record(const std::string& target)
+{
+    stop_recording();
+    FrameWriter* w = new FrameWriter(target, width, height);
+    if (!w->ok()) {
+        delete w;
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    recorder = w;
+    return true;
 }
- 
 
-void Canvas::clear(void)
+void Canvas::stop_recording(void)
 {
-#if !(NO_WINDOW)
+    finish_frames();
+    std::lock_guard<std::mutex> guard(lock);
+    delete recorder;            // waits for the frames to be written
+    recorder = nullptr;
+}
 
-    set_color(BLACK);
-    draw_rectangle(0, 0, width, height, true);
+unsigned long Canvas::frames_drawn(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return num_drawn;
+}
 
-#endif /* !(NO_WINDOW) */
+unsigned long Canvas::frames_dropped(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return num_dropped;
 }
+
+#endif /* RENDER_THREAD */
@@ -1,34 +1,96 @@
 #if !_Window_h
 #define _Window_h 1
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "Color.h"
 
 #if !(NO_WINDOW)
 #include <FL/Fl.H>
 #include <FL/Fl_Double_Window.H>
+class Fl_Widget;
 #endif
 
+class FrameWriter;
+
+/*
+ * A Canvas is a width x height RGB image (3 bytes per pixel, row by row,
+ * the top row first).
+ *
+ * The draw functions do not touch the pixels, they add to a display list
+ * (one DrawCommand per rectangle or line) that clear empties.  flush takes
+ * a copy of the display list (a snapshot of the frame), turns it into
+ * pixels, and shows the whole image in the window at once, as a single
+ * image widget.  With NO_WINDOW (or if the Canvas is not windowed, e.g.
+ * because it belongs to one of several Worlds) there is no window, but
+ * frames can still be saved: after record(target) every frame is also
+ * handed to a FrameWriter (see FrameWriter.h).  A Canvas that has neither
+ * a window nor a FrameWriter isn't watched, and flush doesn't draw
+ * anything at all.
+ *
+ * With RENDER_THREAD, the snapshot is turned into pixels by a render
+ * thread, so the simulation only pays for copying the display list.
+ * If the render thread is still busy with an older snapshot when a new
+ * one is flushed, the older one is dropped (the newest frame always
+ * wins), so slow drawing costs frames, not simulation speed.  While
+ * frames are being saved, none are dropped: flush waits for the render
+ * thread to take the older snapshot instead.  The window
+ * itself is only ever touched by the thread that calls flush, which shows
+ * the newest finished frame and then returns without waiting.
+ */
 class Canvas {
+public:
+    struct DrawCommand {
+        enum Kind { FILL, LINE } kind;
+        Color color;
+        int x1, y1, x2, y2;
+    };
+    typedef std::vector<DrawCommand> DisplayList;
+
 private:
     int width;
     int height;
 
-    unsigned long color_map[8];
     Color color;
+    DisplayList commands;               // what has been drawn since the last clear
+    std::vector<unsigned char> pixels;  // the frame in the window
 
 #if ! (NO_WINDOW)
     Fl_Double_Window *window;  // defined in Fl_Window.H
-#endif 
+    Fl_Widget *view;           // the one widget in window, it draws pixels
+#endif
+    FrameWriter *recorder;     // where frames are saved, if anywhere
+    unsigned long num_drawn = 0;
+    unsigned long num_dropped = 0;
+
+    void rasterize(const DisplayList&, std::vector<unsigned char>&) const;
+    void present(void);
 
-    int scrn;
-    unsigned int plane_mask;
+#if (RENDER_THREAD)
+    /* everything below is shared with the render thread, under lock */
+    std::mutex lock;
+    std::condition_variable changed;
+    DisplayList pending;                // the newest snapshot, not yet rendered
+    bool has_pending = false;
+    std::vector<unsigned char> ready;   // the newest rendered frame, not yet shown
+    bool has_ready = false;
+    bool busy = false;                  // the render thread is rendering
+    bool stopping = false;
+    std::thread renderer;
 
-    /* unsigned */ void initcolor(void);
-    unsigned initmono(void);
+    void render_loop(void);
+    void finish_frames(void);           // wait for the render thread to go idle
+    void stop_render_thread(void);
+#endif /* RENDER_THREAD */
 
 public:
-    Canvas(int width = 600, int height = 450);
-    ~Canvas() {} // should close the window, yes?
+    Canvas(int width = 600, int height = 450, bool windowed = true);
+                                            // without a window, a Canvas just keeps the pixels
+    ~Canvas(); // should close the window, yes?
 
     void set_color(Color);
     void display(void);
@@ -37,7 +99,17 @@ public:
     void draw_rectangle(int x1, int y1, int, int, bool = true);
     void flush(void);
     void clear(void);
+    bool watched(void) const;               // there is a window, or frames are saved
+
+    bool record(const std::string& target); // save every frame from now on
+    void stop_recording(void);              // finish writing the saved frames
+
+    int get_width(void) const { return width; }
+    int get_height(void) const { return height; }
+    const unsigned char* rgb(void) const { return pixels.data(); }  // (if watched)
 
+    unsigned long frames_drawn(void);       // frames turned into pixels
+    unsigned long frames_dropped(void);     // snapshots replaced before they were drawn
 };
 
 #endif /* ! _Window_h */
@@ -0,0 +1,40 @@
+#include "World.h"
+#include "MetricsSink.h"
+#include "Params.h"
+
+thread_local World* World::current_world = nullptr;
+
+/*
+ * only one World (the one the main thread shows) should be windowed,
+ * FLTK can't be used by more than one thread
+ */
+World::World(unsigned long seed, bool windowed)
+    : id(0), win(win_x_size, win_y_size, windowed),
+      space(0.0, 0.0, grid_max, grid_max), seed(seed), random(RandomStream::key(seed, 0))
+{
+}
+
+/*
+ * the pending events are deleted (without running them) and every
+ * LifeForm is marked dead, so that the LifeForms can then be destroyed
+ * along with the events and the QuadTree that refer to them
+ */
+World::~World(void)
+{
+    Scope in(*this);
+    equeue.clear();
+    all_life.bury_all();
+    delete metrics;
+}
+
+bool World::record_metrics(const std::string& target)
+{
+    delete metrics;
+    metrics = new MetricsSink(target);
+    if (!metrics->ok()) {
+        delete metrics;
+        metrics = nullptr;
+        return false;
+    }
+    return true;
+}
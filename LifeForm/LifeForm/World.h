@@ -0,0 +1,163 @@
+#if !(_World_h)
+#define _World_h 1
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Event.h"
+#include "LifeForm.h"
+#include "LifeFormState.h"
+#include "NearbyCache.h"
+#include "ObjInfo.h"
+#include "PerceiveSweep.h"
+#include "PQueue.h"
+#include "Probe.h"
+#include "QuadTree.h"
+#include "Random.h"
+#include "SimTime.h"
+#include "Species.h"
+#include "Window.h"
+
+struct EventProfile;
+class MetricsSink;
+class Replay;
+class Trace;
+
+/*
+ * Class name: World
+ * Description:
+ *  Everything that one simulation changes as it runs: the event queue and
+ *  the clock, the QuadTree, all_life and the species totals, the random
+ *  number generator and the Canvas.  These used to be static data members
+ *  of LifeForm and Event (so there could only ever be one simulation);
+ *  now each World has its own, and any number of Worlds can be simulated
+ *  at once, each one by its own thread.
+ *
+ *  Each thread has a current World (see Scope), and that is the World
+ *  that new LifeForms and Events join, and that Event::now(),
+ *  Event::do_next(), etc. are about.  A LifeForm or an Event stays in the
+ *  World it was created in, and must only be used by that World's thread.
+ *
+ *  What the Worlds share is read only while they run: the table of
+ *  IstreamCreators, the parameters in Params.cpp, and the Species names
+ *  (Species::intern and the SlabPools lock for themselves).
+ *
+ *  Usage:
+ *      World w(seed);
+ *      World::Scope in(w);     // w is the current World until 'in' is destroyed
+ *      LifeForm::create_life();
+ *      while (!w.stopped() && Event::num_events() > 0) { ... }
+ */
+class World {
+public:
+    World(unsigned long seed = 1, bool windowed = true);
+    ~World(void);
+
+    /* the current World of this thread (there must be one) */
+    static World& current(void) { return *current_world; }
+
+    /* makes a World current for as long as the Scope exists */
+    class Scope {
+        World* previous;
+    public:
+        Scope(World& w) : previous(current_world) { current_world = &w; }
+        ~Scope(void) { current_world = previous; }
+    };
+
+    double drand48(void) { return random.next(); }      // uniform in [0, 1)
+    RandomStream new_stream(void) { return RandomStream(RandomStream::key(seed, ++num_streams)); }
+                                // for a new LifeForm (see LifeForm::drand48)
+    uint64_t last_stream(void) const { return num_streams; }    // the number of that stream
+
+    void stop(void) { is_stopped = true; }  // e.g., when the termination strategy says so
+    bool stopped(void) const { return is_stopped; }
+
+    bool record_metrics(const std::string&);    // see MetricsSink.h
+
+    unsigned long id;           // for telling the output of several Worlds apart
+    SimTime max_time = 50000.0; // stop when the simulation reaches this time
+
+    /*
+     * the order matters: members are destroyed from the bottom up, and
+     * all_life must outlive the QuadTree and the cache, because LifeForms
+     * that are destroyed with them remove themselves from all_life
+     */
+    Canvas win;
+    MetricsSink* metrics = nullptr;         // if set, the species summary goes here
+    Trace* trace = nullptr;                 // if set, what happens is recorded here
+    Replay* replay = nullptr;               // if set, the species are played from here
+    EventProfile* profile = nullptr;        // if set, the events that are run are counted here
+    int max_species = 0;                    // the most species ever alive at once
+    LifeFormState all_life;
+    std::vector<SpeciesStats> species_stats;
+    QuadTree<SmartPointer<LifeForm>> space;
+    NearbyCache<SmartPointer<LifeForm>> perceive_cache;
+    PerceiveSweep<SmartPointer<LifeForm>> perceive_sweep;  // with PERCEIVE_SWEEP
+
+    /* in a tile of a TiledWorld, the LifeForms that have run into ghosts
+       (each with the ghost), for the TiledWorld to resolve between windows */
+    std::vector<std::pair<SmartPointer<LifeForm>, SmartPointer<LifeForm>>> border_encounters;
+
+    /* in a logical process of a TimeWarp (see TimeWarp.h): the region it
+       owns, and the LifeForms that have moved out of it, to be sent to
+       the logical process that owns the place they are in now */
+    struct Bounds {
+        double left, bottom, right, top;
+        bool contains(const Point& p) const {
+            return p.xpos >= left && p.xpos < right && p.ypos >= bottom && p.ypos < top;
+        }
+    };
+    const Bounds* owned = nullptr;
+    std::vector<SmartPointer<LifeForm>> strays;
+
+    SimTime now = 0.0;
+    PQueue equeue;
+    uint64_t next_seq = 0;      // the number of the next Event, 0 if Events aren't numbered
+    bool keep_done = false;     // keep the events that have run in done, instead of deleting them
+    std::vector<Event*> done;   // (whoever sets keep_done deletes them)
+
+private:
+    friend class TimeWarp;      // saves and restores random and num_streams
+    friend class Checkpoint;    // and so does a Checkpoint, with the seed
+    friend class Trace;         // which records the seed
+
+    static thread_local World* current_world;
+
+    unsigned long seed;
+    RandomStream random;        // stream 0
+    uint64_t num_streams = 0;   // handed out by new_stream
+    bool is_stopped = false;
+
+    /* a World is a place, it can't be copied */
+    World(const World&) = delete;
+    void operator=(const World&) = delete;
+};
+
+/*
+ * visit everything we can see within 'distance', straight from the
+ * QuadTree (or from the perceive cache, if it is compiled in), unless
+ * the sweep of this instant has found it already
+ */
+template <typename Visitor>
+void LifeForm::look_around(double distance, Visitor visit) {
+#if PERCEIVE_SWEEP
+    if (world->perceive_sweep.visit_nearby(world->space, pos(), distance, Event::now(), visit)) return;
+#endif /* PERCEIVE_SWEEP */
+#if PERCEIVE_CACHE
+    world->perceive_cache.visit_nearby(world->space, pos(), distance, Event::now(), visit);
+#else
+    world->space.visit_nearby(pos(), distance, visit);
+#endif /* PERCEIVE_CACHE */
+}
+
+template <typename Visitor>
+void LifeForm::perceive_each(double distance, Visitor visit) {
+    PROBE("LifeForm::perceive");
+    if (!pay_to_perceive(distance)) return;
+    look_around(distance,
+        [this, &visit](const SmartPointer<LifeForm>& other) { visit(info_about_them(other)); });
+}
+
+#endif /* !(_World_h) */
@@ -1,18 +1,22 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 #include "LifeForm.h"
 #include "Algae.h"
+#include "Checkpoint.h"
 #include "Event.h"
 #include "Params.h"
-#include "Random.h"
-
-namespace epl {
-    std::default_random_engine random_generator;
-    std::function<double(void)> drand48 = std::bind(std::uniform_real_distribution<double>{}, random_generator);
-}
+#include "Replay.h"
+#include "ShardedWorld.h"
+#include "TiledWorld.h"
+#include "TimeWarp.h"
+#include "Trace.h"
+#include "World.h"
 
 using namespace std;
-using namespace epl;
 const double Point::tolerance = 1.0e-6;
 
 bool LifeForm::testMode = false;
@@ -21,45 +25,286 @@ void LifeForm::runTests(void) {}
 /* The Tick class creates an event every 1.00 time units
 * The event is used to add new Algae to the simulation and can
 * also be used to add debugging hooks if you need them
+* (it is an event of a kind, see Event.h, so it can be saved in a checkpoint)
 */
 class Tick {
 public:
-    static void tock(void) {
-        std::function<void(void)> callme = [](void) { tock(); };
+    static void tock(LifeForm* = nullptr, double = 0.0) {
 #if ALGAE_SPORES    
         Algae::create_spontaneously();
 #endif /* ALGAE_SPORES */
         if (Event::num_events() > 1)
-            (void) new Event(1, callme);
+            (void) new Event(1, &tock);
     }
 };
 
-void delay(void) {
+/* slow the simulation down to a watchable speed (there is nothing
+   to watch without a window) */
+void delay(LifeForm*, double) {
+#if !(NO_WINDOW)
     std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+#endif /* !(NO_WINDOW) */
     new Event(1, &delay);
 }
 
-int main(int argc, char** argv) {
-    double last_time = 0.0;
-    double time_lapse;
-
-    if (argc > 1)
-        time_lapse = atof(argv[1]);
-    else
-        time_lapse = 1.0;
+/*
+ * run the simulation of one World until it stops (or runs out of events),
+ * redisplaying everything every time_lapse time units.  The World starts
+ * from config.test, or from the checkpoint 'resume' if there is one, and
+ * if there are 'checkpoints' one is saved every checkpoint_interval time
+ * units.  false if the checkpoint couldn't be restored
+ */
+bool simulate(World& world, double time_lapse, const string& resume, Checkpoint* checkpoints) {
+    World::Scope in(world);
 
-    LifeForm::create_life();
-    new Event(1, &delay);
-    Tick::tock();
-    while (Event::num_events() > 0) {
+    if (resume.empty()) {
+        LifeForm::create_life();
+        new Event(1, &delay);
+        Tick::tock();
+    }
+    else if (!Checkpoint::restore(world, resume)) {
+        return false;
+    }
+    double last_time = Event::now();
+    double last_saved = Event::now();
+    while (!world.stopped() && Event::num_events() > 0) {
         Event::do_next();
         // periodically redisplay everything
         if (Event::now() - last_time > time_lapse) {
             last_time = Event::now();
             LifeForm::redisplay_all();
+            if (checkpoints && Event::now() - last_saved >= checkpoint_interval) {
+                last_saved = Event::now();
+                if (!checkpoints->save(world)) checkpoints = nullptr;   // it never will be
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * the same for one simulation spread over across x across tiles, see
+ * TiledWorld.h (or TimeWarp.h).  The spores (one per time unit, as Tick makes them) are
+ * made between windows
+ */
+void simulate(TiledWorld& tiles, double time_lapse) {
+    std::function<void(void)> spore = nullptr;
+#if ALGAE_SPORES
+    spore = [](void) { Algae::create_spontaneously(); };
+#endif /* ALGAE_SPORES */
+    tiles.simulate(time_lapse, [](void) { LifeForm::populate(); }, spore);
+}
+
+/* the same for one simulation spread over several processes, see ShardedWorld.h */
+bool simulate(ShardedWorld& shards, double time_lapse) {
+    std::function<void(void)> spore = nullptr;
+#if ALGAE_SPORES
+    spore = [](void) { Algae::create_spontaneously(); };
+#endif /* ALGAE_SPORES */
+    return shards.simulate(time_lapse, [](void) { LifeForm::populate(); }, spore);
+}
+
+/* target, with "-<id>" added before its extension, so that each World gets its own */
+static string for_world(const string& target, unsigned long id) {
+    if (target.empty() || target[0] == '|') return target;
+    size_t slash = target.find_last_of('/');
+    size_t dot = target.find_last_of('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) dot = target.size();
+    return target.substr(0, dot) + "-" + to_string(id) + target.substr(dot);
+}
+
+/*
+ * the frames drawn (and dropped) in a World, on cerr: how many there
+ * are depends on how far the render thread has got, so they are kept
+ * out of the summary, which must be the same from run to run
+ */
+static void report_frames(World& world) {
+    unsigned long drawn = world.win.frames_drawn();
+    unsigned long dropped = world.win.frames_dropped();
+    if (drawn + dropped == 0) return;
+    string w = world.id ? "World " + to_string(world.id) + ": " : "";
+    cerr << w + "Frames: " + to_string(drawn) + " drawn, " + to_string(dropped) + " dropped\n";
+}
+
+/*
+ * usage: animals [time_lapse] [-o target] [-m file] [-c file] [-r file]
+ *                [-x file] [-R file] [-w worlds] [-t tiles] [-T lps] [-P shards]
+ *   time_lapse is the simulated time between redisplays (default 1.0)
+ *   -o saves every redisplayed frame, see FrameWriter.h for the targets
+ *      (e.g. -o frames/f%05d.ppm)
+ *   -m writes the species summary to a CSV (file.csv) or JSON Lines
+ *      (any other name) file instead of printing it, see MetricsSink.h
+ *   -c saves a checkpoint of the simulation in file every
+ *      checkpoint_interval time units, see Checkpoint.h
+ *   -r starts the simulation from a checkpoint file instead of from
+ *      config.test
+ *   -x records a trace of the simulation in file, see Trace.h
+ *   -R replays the trace in file (in a World with no window, with the
+ *      species played by Puppets, see Replay.h), and says whether the
+ *      run went as traced
+ *   -w simulates that many Worlds at once, each on its own thread, with
+ *      its own random seed (1, 2, ...) and no window.  The summaries are
+ *      labelled with the number of the World, and each World saves to
+ *      its own copy of the -o, -m, -c and -x targets (e.g. run-2.csv), and
+ *      restores from its own copy of the -r file
+ *   -t simulates one World cut into tiles x tiles tiles, each on its own
+ *      thread and with no window (and nothing for -o to save)
+ *   -T is the same as -t, but runs the tiles optimistically, as the
+ *      logical processes of a TimeWarp, and reports how much was rolled back
+ *   -P simulates one World cut into that many stripes, each in a process
+ *      of its own, with no window (and nothing for -o to save)
+ *   (-c, -r, -x and -R can't be used with -t, -T or -P, -x can't be used
+ *   with -r, and -R can't be used with -w, -c, -r or -x)
+ */
+int main(int argc, char** argv) {
+    double time_lapse = 1.0;
+    string frames, metrics, checkpoints, resume, tracing, replaying;
+    unsigned long num_worlds = 1;
+    unsigned long num_tiles = 0;
+    unsigned long num_shards = 0;
+    bool optimistic = false;
+
+    for (int k = 1; k < argc; k++) {
+        if (string(argv[k]) == "-o" && k + 1 < argc) {
+            k += 1;
+            frames = argv[k];
+        }
+        else if (string(argv[k]) == "-m" && k + 1 < argc) {
+            k += 1;
+            metrics = argv[k];
+        }
+        else if (string(argv[k]) == "-c" && k + 1 < argc) {
+            k += 1;
+            checkpoints = argv[k];
+        }
+        else if (string(argv[k]) == "-r" && k + 1 < argc) {
+            k += 1;
+            resume = argv[k];
+        }
+        else if (string(argv[k]) == "-x" && k + 1 < argc) {
+            k += 1;
+            tracing = argv[k];
+        }
+        else if (string(argv[k]) == "-R" && k + 1 < argc) {
+            k += 1;
+            replaying = argv[k];
+        }
+        else if (string(argv[k]) == "-w" && k + 1 < argc) {
+            k += 1;
+            num_worlds = max(1l, atol(argv[k]));
+        }
+        else if (string(argv[k]) == "-t" && k + 1 < argc) {
+            k += 1;
+            num_tiles = max(1l, atol(argv[k]));
+        }
+        else if (string(argv[k]) == "-T" && k + 1 < argc) {
+            k += 1;
+            num_tiles = max(1l, atol(argv[k]));
+            optimistic = true;
+        }
+        else if (string(argv[k]) == "-P" && k + 1 < argc) {
+            k += 1;
+            num_shards = max(1l, atol(argv[k]));
+        }
+        else {
+            time_lapse = atof(argv[k]);
+        }
+    }
+
+    Event::add_kind(&Tick::tock, "Tick::tock");
+    Event::add_kind(&delay, "delay");
+    if ((num_shards > 0 || num_tiles > 0)
+        && !(checkpoints.empty() && resume.empty() && tracing.empty() && replaying.empty())) {
+        cerr << "animals: -c, -r, -x and -R can't be used with -t, -T or -P\n";
+        return 1;
+    }
+    if (!tracing.empty() && !resume.empty()) {
+        cerr << "animals: -x can't be used with -r\n";
+        return 1;
+    }
+    if (!replaying.empty()
+        && (num_worlds > 1 || !(checkpoints.empty() && resume.empty() && tracing.empty()))) {
+        cerr << "animals: -R can't be used with -w, -c, -r or -x\n";
+        return 1;
+    }
+
+    if (num_shards > 0) {
+        ShardedWorld shards((unsigned) num_shards);
+        if (!metrics.empty() && !shards.totals.record_metrics(metrics)) return 1;
+        if (!simulate(shards, time_lapse)) return 1;
+    }
+    else if (num_tiles > 0 && optimistic) {
+        TimeWarp lps((unsigned) num_tiles);
+        if (!metrics.empty() && !lps.totals.record_metrics(metrics)) return 1;
+        simulate(lps, time_lapse);
+    }
+    else if (num_tiles > 0) {
+        TiledWorld tiles((unsigned) num_tiles);
+        if (!metrics.empty() && !tiles.totals.record_metrics(metrics)) return 1;
+        simulate(tiles, time_lapse);
+    }
+    else if (!replaying.empty()) {
+        Replay replay(replaying);
+        if (!replay.ok()) return 1;
+        World world(replay.seed(), false);
+        if (!metrics.empty() && !world.record_metrics(metrics)) return 1;
+        replay.install(world);
+        simulate(world, time_lapse, "", nullptr);
+        if (!replay.summary()) return 1;
+    }
+    else if (num_worlds == 1) {
+        World world;
+        if (!frames.empty() && !world.win.record(frames)) return 1;
+        if (!metrics.empty() && !world.record_metrics(metrics)) return 1;
+        unique_ptr<Checkpoint> saving;
+        if (!checkpoints.empty()) saving.reset(new Checkpoint(checkpoints));
+        unique_ptr<Trace> trace;
+        if (!tracing.empty()) {
+            trace.reset(new Trace(tracing, world));
+            if (!trace->ok()) return 1;
+            world.trace = trace.get();
+        }
+        if (!simulate(world, time_lapse, resume, saving.get())) return 1;
+        world.trace = nullptr;
+        world.win.stop_recording();
+        report_frames(world);
+    }
+    else {
+        vector<unique_ptr<World>> worlds;
+        vector<unique_ptr<Checkpoint>> saving(num_worlds);
+        vector<unique_ptr<Trace>> traces(num_worlds);
+        for (unsigned long id = 1; id <= num_worlds; id += 1) {
+            worlds.emplace_back(new World(id, false));
+            World& world = *worlds.back();
+            world.id = id;
+            if (!frames.empty() && !world.win.record(for_world(frames, id))) return 1;
+            if (!metrics.empty() && !world.record_metrics(for_world(metrics, id))) return 1;
+            if (!checkpoints.empty()) saving[id - 1].reset(new Checkpoint(for_world(checkpoints, id)));
+            if (!tracing.empty()) {
+                traces[id - 1].reset(new Trace(for_world(tracing, id), world));
+                if (!traces[id - 1]->ok()) return 1;
+                world.trace = traces[id - 1].get();
+            }
+        }
+        vector<thread> threads;
+        vector<char> ok(num_worlds, true);
+        for (unsigned long k = 0; k < num_worlds; k += 1) {
+            World* world = worlds[k].get();
+            string from = resume.empty() ? resume : for_world(resume, k + 1);
+            Checkpoint* c = saving[k].get();
+            char* good = &ok[k];
+            threads.emplace_back([world, time_lapse, from, c, good](void) {
+                *good = simulate(*world, time_lapse, from, c);
+                world->trace = nullptr;
+                world->win.stop_recording();
+                report_frames(*world);
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
         }
+        if (find(ok.begin(), ok.end(), false) != ok.end()) return 1;
     }
 
-    cerr << "Simulation Complete, hit ^C to terminate program\n";
-    //  sleep(1000);
+    cerr << "Simulation Complete\n";
 }
@@ -0,0 +1,369 @@
+/*
+ * bench: measures the simulator the same way every time
+ *
+ * usage: bench [-o results.jsonl] [-c baseline.jsonl] [-s seed]
+ *              [-t time] [-n max_population] [-r runs] [scenario ...]
+ *   runs each scenario (all of them if none is named) at each population
+ *   (1000, 4000, 16000 and 64000, up to max_population) for time units
+ *   of simulated time (default 20), each run in a process of its own,
+ *   and prints a table of the results
+ *   -o also writes them to a JSON Lines file, one line per run
+ *   -c compares the events per second of every run with the same run in
+ *      a results file that -o wrote before (e.g., before a change)
+ *   -s is the seed of the Worlds, and of where the clusters go (default 1)
+ *   -r runs each one that many times (default 3), and keeps the fastest
+ *
+ * The scenarios are config.test files (see README.txt, item 4) that are
+ * written from the seed, so a scenario at a population is always the
+ * same simulation:
+ *   algae      only Algae, anywhere in the middle of the grid
+ *   craig      Algae, and one Craig for every nine of them
+ *   clusters   the same mix, packed into 16 dense circles
+ *   sparse     the same mix, a sixteenth as many, anywhere in the grid
+ * The grid is grid_max (see Params.cpp) on a side, and populate keeps
+ * every LifeForm encounter_distance from the others, so a population
+ * that would be too dense to place is skipped.
+ *
+ * For each run it reports the events that were run and how many a
+ * second, the time per event of each kind (see EventProfile in
+ * Event.h), the peak resident set size, the memory that populating took
+ * per LifeForm, and the depth of the QuadTree (after populating, and
+ * at the end).
+ */
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Algae.h"
+#include "Event.h"
+#include "LifeForm.h"
+#include "Params.h"
+#include "Probe.h"
+#include "Random.h"
+#include "World.h"
+
+using namespace std;
+const double Point::tolerance = 1.0e-6;
+
+bool LifeForm::testMode = false;
+void LifeForm::runTests(void) {}
+
+/* the spores, one every time unit, as animals makes them */
+static void spores(LifeForm* = nullptr, double = 0.0) {
+#if ALGAE_SPORES
+    Algae::create_spontaneously();
+#endif /* ALGAE_SPORES */
+    if (Event::num_events() > 1)
+        (void) new Event(1, &spores);
+}
+
+struct Scenario {
+    string name;
+    unsigned long population;   // LifeForms at the start
+    string config;              // its config.test
+};
+
+/* the most LifeForms per unit of area that populate places without trouble */
+static const double max_density = 0.5;
+
+static string mix(unsigned long population, const string& where) {
+    unsigned long craig = population / 10;
+    ostringstream s;
+    s << "Algae " << population - craig << where << "\n";
+    if (craig > 0) s << "Craig " << craig << where << "\n";
+    return s.str();
+}
+
+/*
+ * population as Scenario name (one of the four above), or false if it
+ * won't fit.  The clusters are in a 4 x 4 grid of cells (moved about in
+ * their cells, by the seed), with 0.3 LifeForms per unit of area, or
+ * more if they would be bigger than their cells
+ */
+static bool make_scenario(const string& name, unsigned long population, unsigned long seed,
+                          Scenario& out) {
+    const double side = grid_max * 0.75;      // where populate puts them
+    out.name = name;
+    out.population = population;
+    if (name == "algae") {
+        out.config = "Algae " + to_string(population) + "\n";
+        return population <= max_density * side * side;
+    }
+    if (name == "craig") {
+        out.config = mix(population, "");
+        return population <= max_density * side * side;
+    }
+    if (name == "sparse") {
+        out.population = population / 16;
+        ostringstream where;
+        where << " " << grid_max / 2.0 << " " << grid_max / 2.0 << " " << grid_max / 2.0 - 1.0;
+        out.config = mix(out.population, where.str());
+        return true;
+    }
+    if (name == "clusters") {
+        const unsigned across = 4;
+        const double cell = side / across;
+        RandomStream r(RandomStream::key(seed, ~0ull));     // a stream no World hands out
+        unsigned long each = population / (across * across);
+        out.population = each * across * across;
+        double radius = min(sqrt(each / (0.3 * M_PI)), cell / 2.0);
+        if (each > max_density * M_PI * radius * radius) return false;
+        out.config.clear();
+        for (unsigned k = 0; k < across * across; k += 1) {
+            double slack = cell / 2.0 - radius;
+            double x = grid_max / 8.0 + (k % across + 0.5) * cell + (r.next() * 2.0 - 1.0) * slack;
+            double y = grid_max / 8.0 + (k / across + 0.5) * cell + (r.next() * 2.0 - 1.0) * slack;
+            ostringstream where;
+            where << " " << x << " " << y << " " << radius;
+            out.config += mix(each, where.str());
+        }
+        return true;
+    }
+    return false;
+}
+
+/* in kilobytes */
+static long peak_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;      // (in bytes there)
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/* run one scenario in this process, and describe it as one JSON object */
+static string run(const Scenario& scenario, unsigned long seed, double time) {
+    ofstream("config.test") << scenario.config;
+
+    long before = peak_rss();
+    World world(seed, false);
+    World::Scope in(world);
+    LifeForm::populate();
+    long populated = peak_rss();
+    unsigned start_depth = world.space.depth();
+
+    EventProfile profile;
+    world.profile = &profile;
+    spores();
+    auto start = chrono::steady_clock::now();
+    uint64_t start_ticks = Probe::ticks();
+    Event::do_until(time);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t ticks = Probe::ticks() - start_ticks;
+    world.profile = nullptr;
+
+    double ns_per_tick = ticks > 0 ? seconds * 1.0e9 / ticks : 0.0;
+    unsigned long events = 0;
+    map<string, EventProfile::Count> kinds;     // by name, so they come out in order
+    for (const auto& k : profile.kinds) {
+        const string* name = Event::kind_name(k.first);
+        EventProfile::Count& c = kinds[name ? *name : "(closure)"];
+        c.events += k.second.events;
+        c.ticks += k.second.ticks;
+        events += k.second.events;
+    }
+
+    ostringstream s;
+    s << "{\"scenario\":\"" << scenario.name << "\",\"population\":" << scenario.population
+      << ",\"seed\":" << seed << ",\"time\":" << time << ",\"events\":" << events
+      << ",\"seconds\":" << seconds << ",\"events_per_sec\":" << (seconds > 0 ? events / seconds : 0.0)
+      << ",\"alive\":" << world.all_life.num_alive()
+      << ",\"peak_rss_kb\":" << peak_rss()
+      << ",\"bytes_per_lifeform\":"
+      << (scenario.population ? (populated - before) * 1024.0 / scenario.population : 0.0)
+      << ",\"quadtree_depth\":" << start_depth << ",\"quadtree_depth_end\":" << world.space.depth()
+      << ",\"kinds\":{";
+    const char* comma = "";
+    for (const auto& k : kinds) {
+        s << comma << "\"" << k.first << "\":{\"events\":" << k.second.events
+          << ",\"ns_per_event\":" << k.second.ticks * ns_per_tick / k.second.events << "}";
+        comma = ",";
+    }
+    s << "}}";
+    return s.str();
+}
+
+/*
+ * run it in a child process, so that its peak RSS is its own and
+ * nothing it leaves behind slows the next one down.  "" if it failed
+ */
+static string run_apart(const Scenario& scenario, unsigned long seed, double time) {
+    int fds[2];
+    if (pipe(fds) != 0) return "";
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) return "";
+    if (pid == 0) {
+        close(fds[0]);
+        if (freopen("/dev/null", "w", stdout) == nullptr) _exit(1);  // the simulator's chatter
+        string line = run(scenario, seed, time);
+        for (size_t done = 0; done < line.size(); ) {
+            ssize_t n = write(fds[1], line.data() + done, line.size() - done);
+            if (n <= 0) _exit(1);
+            done += n;
+        }
+        _exit(0);               // (tearing the World down isn't part of it)
+    }
+    close(fds[1]);
+    string line;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        line.append(buffer, n);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return "";
+    return line;
+}
+
+/* the value of field in a line that run wrote ("" if there isn't one) */
+static string field(const string& line, const string& name) {
+    string key = "\"" + name + "\":";
+    size_t at = line.find(key);
+    if (at == string::npos) return "";
+    at += key.size();
+    if (line[at] == '"') {
+        size_t end = line.find('"', at + 1);
+        return line.substr(at + 1, end - at - 1);
+    }
+    size_t end = line.find_first_of(",}", at);
+    return line.substr(at, end - at);
+}
+
+int main(int argc, char** argv) {
+    string results, baseline;
+    unsigned long seed = 1;
+    double time = 20.0;
+    unsigned long max_population = 64000;
+    unsigned long runs = 3;
+    vector<string> names;
+
+    for (int k = 1; k < argc; k++) {
+        if (string(argv[k]) == "-o" && k + 1 < argc) {
+            k += 1;
+            results = argv[k];
+        }
+        else if (string(argv[k]) == "-c" && k + 1 < argc) {
+            k += 1;
+            baseline = argv[k];
+        }
+        else if (string(argv[k]) == "-s" && k + 1 < argc) {
+            k += 1;
+            seed = max(1l, atol(argv[k]));
+        }
+        else if (string(argv[k]) == "-t" && k + 1 < argc) {
+            k += 1;
+            time = atof(argv[k]);
+        }
+        else if (string(argv[k]) == "-r" && k + 1 < argc) {
+            k += 1;
+            runs = max(1l, atol(argv[k]));
+        }
+        else if (string(argv[k]) == "-n" && k + 1 < argc) {
+            k += 1;
+            max_population = max(1l, atol(argv[k]));
+        }
+        else {
+            names.push_back(argv[k]);
+        }
+    }
+    Event::add_kind(&spores, "spores");
+    const vector<string> all = { "algae", "craig", "clusters", "sparse" };
+    if (names.empty()) names = all;
+    for (const string& name : names) {
+        if (find(all.begin(), all.end(), name) == all.end()) {
+            cerr << "bench: there is no scenario " << name << "\n";
+            return 1;
+        }
+    }
+
+    ofstream out;
+    if (!results.empty()) {
+        out.open(results);
+        if (!out) {
+            cerr << "bench: cannot write " << results << "\n";
+            return 1;
+        }
+    }
+    map<pair<string, string>, double> before;   // events/sec, by scenario and population
+    if (!baseline.empty()) {
+        ifstream in(baseline);
+        if (!in) {
+            cerr << "bench: cannot open " << baseline << "\n";
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) {
+            string rate = field(line, "events_per_sec");
+            if (!rate.empty()) before[make_pair(field(line, "scenario"), field(line, "population"))] = stod(rate);
+        }
+    }
+
+    /* the config.test files go in a directory of our own */
+    char scratch[] = "/tmp/bench-XXXXXX";
+    if (mkdtemp(scratch) == nullptr || chdir(scratch) != 0) {
+        cerr << "bench: cannot make a directory to work in\n";
+        return 1;
+    }
+
+    printf("%-9s %10s %10s %12s %10s %10s %10s %6s\n", "scenario", "population", "events",
+           "events/sec", "ns/event", "peak MB", "bytes/LF", "depth");
+    bool failed = false;
+    for (const string& name : names) {
+        for (unsigned long population = 1000; population <= max_population; population *= 4) {
+            Scenario scenario;
+            if (!make_scenario(name, population, seed, scenario)) {
+                printf("%-9s %10lu   (too many for the grid)\n", name.c_str(), population);
+                continue;
+            }
+            string line;
+            for (unsigned long k = 0; k < runs; k += 1) {
+                string next = run_apart(scenario, seed, time);
+                if (next.empty()) {
+                    line.clear();
+                    break;
+                }
+                if (line.empty() || stod(field(next, "events_per_sec")) > stod(field(line, "events_per_sec"))) {
+                    line = next;
+                }
+            }
+            if (line.empty()) {
+                printf("%-9s %10lu   (failed)\n", name.c_str(), scenario.population);
+                failed = true;
+                continue;
+            }
+            if (out.is_open()) out << line << "\n";
+            double rate = stod(field(line, "events_per_sec"));
+            printf("%-9s %10lu %10s %12.0f %10.1f %10.1f %10.0f %3s/%-2s", name.c_str(),
+                   scenario.population, field(line, "events").c_str(), rate,
+                   rate > 0 ? 1.0e9 / rate : 0.0, stol(field(line, "peak_rss_kb")) / 1024.0,
+                   stod(field(line, "bytes_per_lifeform")), field(line, "quadtree_depth").c_str(),
+                   field(line, "quadtree_depth_end").c_str());
+            auto b = before.find(make_pair(name, to_string(scenario.population)));
+            if (b != before.end() && b->second > 0) {
+                printf("  %+.1f%%", (rate / b->second - 1.0) * 100.0);
+            }
+            printf("\n");
+        }
+    }
+
+    unlink("config.test");
+    if (chdir("/") == 0) rmdir(scratch);
+    return failed ? 1 : 0;
+}